@@ -0,0 +1,233 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Benchmark runner.
+//
+// Each script given on the command line is loaded into a fresh root
+// context and every global function whose name starts with "bench-"
+// is then timed.  A benchmark is run repeatedly (in a loop long
+// enough to time reliably) for a few warmup rounds and then for the
+// measured repetitions; we report the median and minimum time per
+// call.
+//
+// Results can be written as tab-separated values and compared with
+// an earlier run; the runner fails if any benchmark's minimum got
+// slower than the baseline's by more than the threshold.  Minimums
+// are compared since medians are much noisier (the two are often 20%
+// apart from one run to the next).
+
+#include <sic.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace sic;
+
+using clock_type = std::chrono::steady_clock;
+
+struct options {
+    int warmup = 2;
+    int reps = 7;
+    double min_sample_ms = 20;      // Loop until a sample takes this long
+    double threshold = 10;          // Allowed slowdown, in percent
+    std::string output, baseline;
+    std::vector<std::string> scripts;
+};
+
+struct result {
+    std::string name;
+    long iterations;
+    double median_us, min_us;
+};
+
+
+static void
+usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [-w warmup] [-n reps] [-o results.tsv]"
+              << " [-b baseline.tsv] [-t percent] script ...\n";
+    exit(2);
+}// usage
+
+
+static double
+time_calls(obj *call, context *root, long iterations) {
+    clock_type::time_point start = clock_type::now();
+    for (long i = 0; i < iterations; ++i) {
+        eval(call, root);
+    }
+    return std::chrono::duration<double, std::micro>(
+        clock_type::now() - start).count();
+}// time_calls
+
+
+static result
+run_benchmark(const std::string& name, context *root, const options& opts) {
+    obj *call = $( $$(name) );
+
+    // Find a loop count that makes each sample long enough to time.
+    long iterations = 1;
+    while (true) {
+        double us = time_calls(call, root, iterations);
+        if (us >= opts.min_sample_ms * 1000 || iterations >= (1L << 30)) {
+            break;
+        }
+        iterations = (long)(iterations *
+                            (us > 0 ? std::max(2.0, opts.min_sample_ms * 1000 / us)
+                                    : 10));
+    }
+
+    for (int i = 0; i < opts.warmup; ++i) {
+        time_calls(call, root, iterations);
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < opts.reps; ++i) {
+        samples.push_back(time_calls(call, root, iterations) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    return { name, iterations, samples[samples.size() / 2], samples.front() };
+}// run_benchmark
+
+
+static std::vector<result>
+run_script(const std::string& path, const options& opts) {
+    context *root = root_context();
+
+    // Not load(); we don't want cache files here.
+    mapped_file source(path);
+    buffer_reader reader(source.text());
+    for (obj *expr = reader.read(); expr; expr = reader.read()) {
+        eval(expr, root);
+    }
+
+    // Strip the directory and extension to prefix the names.
+    std::string base = path.substr(path.find_last_of('/') + 1);
+    base = base.substr(0, base.find_last_of('.'));
+
+    std::vector<result> results;
+    for (const auto& item : root->bindings()) {
+        if (item.first.compare(0, 6, "bench-") != 0) { continue; }
+        if (!dynamic_cast<function*>(item.second)) { continue; }
+
+        result r = run_benchmark(item.first, root, opts);
+        r.name = base + "/" + r.name.substr(6);
+        results.push_back(r);
+    }
+
+    return results;
+}// run_script
+
+
+// Read the minimum time of each benchmark from 'path'.
+static std::map<std::string, double>
+read_baseline(const std::string& path) {
+    std::map<std::string, double> minimums;
+
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Unable to open baseline '" << path << "'\n";
+        exit(2);
+    }
+
+    std::string line;
+    std::getline(in, line);     // Header
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        long iterations;
+        double median, min;
+        if (fields >> name >> iterations >> median >> min) {
+            minimums[name] = min;
+        }
+    }
+
+    return minimums;
+}// read_baseline
+
+
+int
+main(int argc, char *argv[]) {
+    options opts;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:n:o:b:t:")) != -1) {
+        switch (opt) {
+        case 'w': opts.warmup = atoi(optarg);       break;
+        case 'n': opts.reps = atoi(optarg);         break;
+        case 'o': opts.output = optarg;             break;
+        case 'b': opts.baseline = optarg;           break;
+        case 't': opts.threshold = atof(optarg);    break;
+        default: usage(argv[0]);
+        }
+    }
+    for (int i = optind; i < argc; ++i) { opts.scripts.push_back(argv[i]); }
+    if (opts.scripts.empty() || opts.reps < 1) { usage(argv[0]); }
+
+    std::map<std::string, double> baseline;
+    if (!opts.baseline.empty()) { baseline = read_baseline(opts.baseline); }
+
+    std::vector<result> results;
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-36s %12s %12s %12s %8s\n",
+             "benchmark", "median us", "min us", "baseline min", "change");
+    std::cout << line;
+
+    int regressions = 0;
+    for (const std::string& script : opts.scripts) {
+        try {
+            for (const result& r : run_script(script, opts)) {
+                results.push_back(r);
+
+                std::string base = "", change = "";
+                auto found = baseline.find(r.name);
+                if (found != baseline.end() && found->second > 0) {
+                    double pct = 100 * (r.min_us / found->second - 1);
+                    snprintf(line, sizeof(line), "%.3f", found->second);
+                    base = line;
+                    snprintf(line, sizeof(line), "%+.1f%%", pct);
+                    change = line;
+                    if (pct > opts.threshold) {
+                        change += " !";
+                        ++regressions;
+                    }
+                }
+
+                snprintf(line, sizeof(line), "%-36s %12.3f %12.3f %12s %8s\n",
+                         r.name.c_str(), r.median_us, r.min_us, base.c_str(),
+                         change.c_str());
+                std::cout << line << std::flush;
+            }
+        } catch (const error& e) {
+            std::cerr << script << ": ERROR: " << e.longmsg() << "\n";
+            return 2;
+        }
+    }// for
+
+    if (!opts.output.empty()) {
+        std::ofstream out(opts.output);
+        out << "benchmark\titerations\tmedian_us\tmin_us\n";
+        for (const result& r : results) {
+            out << r.name << "\t" << r.iterations << "\t" << r.median_us
+                << "\t" << r.min_us << "\n";
+        }
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " benchmark(s) more than "
+                  << opts.threshold << "% slower than the baseline.\n";
+        return 1;
+    }
+
+    return 0;
+}// main
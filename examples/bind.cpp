@@ -0,0 +1,37 @@
+
+#include <sic.hpp>
+
+#include <cmath>
+#include <string>
+
+using namespace sic;
+
+// Make some C++ functions callable from Sic.
+
+static double hypotenuse(double a, double b) { return std::sqrt(a*a + b*b); }
+
+static long count_char(std::string_view s, std::string_view c) {
+    return c.empty() ? 0 : (long)std::count(s.begin(), s.end(), c[0]);
+}
+
+static std::string shout(const std::string& s) {
+    std::string result = s;
+    for (char& c : result) { c = toupper(c); }
+    return result + "!";
+}
+
+static bool is_even(long n) { return n % 2 == 0; }
+
+int main() {
+    context *root = root_context();
+
+    bind_native(root, "hypotenuse", &hypotenuse);
+    bind_native(root, "count-char", &count_char);
+    bind_native(root, "shout", &shout);
+    bind_native(root, "even?", &is_even);
+
+    eval(read("(print (hypotenuse 3 4) \" \" (count-char \"banana\" \"a\") \" \""
+              "       (shout \"hello\") \" \" (even? 4) (even? 5) \"\\n\")"),
+         root);
+    return 0;
+}
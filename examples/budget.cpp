@@ -0,0 +1,66 @@
+
+#include <sic.hpp>
+
+#include <iostream>
+#include <thread>
+
+using namespace sic;
+
+// Run untrusted expressions with limits on how much work they can do.
+
+static void
+run(context *root, const char *expr, budget& limits) {
+    try {
+        obj *result = eval(read(expr), root);
+        std::cout << expr << " => " << printstr(result) << "\n";
+    } catch (const budget_exceeded& e) {
+        std::cout << expr << ": " << e.what() << " after "
+                  << limits.used() << " steps\n";
+    }
+}
+
+int main() {
+    context *root = root_context();
+    eval(read("(defun spin () (while t nil))"), root);
+    eval(read("(defun deep (n) (+ 1 (deep n)))"), root);
+
+    {
+        budget limits;
+        limits.steps(100000);
+        run(root, "(fold + 0 (range 100))", limits);
+        run(root, "(spin)", limits);
+    }
+
+    {
+        budget limits;
+        limits.max_depth(500);
+        run(root, "(deep 1)", limits);
+    }
+
+    {
+        budget limits;
+        limits.timeout(std::chrono::milliseconds(50));
+        run(root, "(spin)", limits);
+    }
+
+    {
+        budget limits;
+        limits.memory(1 << 20);
+        run(root, "(to-list (range 1000000))", limits);
+    }
+
+    {
+        std::atomic<bool> stop(false);
+        std::thread canceller([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                stop = true;
+            });
+
+        budget limits;
+        limits.cancel_flag(&stop);
+        run(root, "(spin)", limits);
+        canceller.join();
+    }
+
+    return 0;
+}
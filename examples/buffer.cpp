@@ -0,0 +1,29 @@
+
+#include <sic.hpp>
+
+#include <iostream>
+#include <vector>
+
+using namespace sic;
+
+// Let Sic read a C++ array without copying it.
+
+int main() {
+    context *root = root_context();
+
+    std::vector<double> samples;
+    for (int i = 1; i <= 10; ++i) { samples.push_back(i * 0.5); }
+
+    int16_t *raw = new int16_t[4] { -2, 7, 300, 12 };
+
+    root->define("samples",
+                 new foreign_buffer(samples.data(), samples.size()));
+    root->define("raw",
+                 new foreign_buffer(raw, 4, [raw]() { delete[] raw; }));
+
+    eval(read("(print (fold + 0 samples) \" \" (nth samples 3) \" \""
+              "       (map (fun (x) (* x x)) (slice raw 1 3)) \" \""
+              "       (buffer-type raw) \" \" (llen (slice samples 8)) \"\\n\")"),
+         root);
+    return 0;
+}
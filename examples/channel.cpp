@@ -0,0 +1,47 @@
+
+#include <sic.hpp>
+#include <thread>
+
+using namespace sic;
+
+// Two interpreters, each with its own root context, running in
+// separate threads and talking over a channel.
+
+static obj *
+producer() {
+    return
+        $(let, $( $( $$("n"), 1) ),
+          $(while_op, $(le, $$("n"), 10),
+            $(send, $$("ch"), $(list, $$("n"), $(mul, $$("n"), $$("n")))),
+            $(setq, $$("n"), $(add, $$("n"), 1))),
+          $(send, $$("ch"), $(quote, $$("done")))
+            );
+}
+
+static obj *
+consumer() {
+    return
+        $(let, $( $( $$("item"), $(recv, $$("ch")) ) ),
+          $(while_op, $(ne_p, $$("item"), $(quote, $$("done"))),
+            $(print, $(first, $$("item")), " squared is ",
+              $(second, $$("item")), "\n"),
+            $(setq, $$("item"), $(recv, $$("ch"))))
+            );
+}
+
+int main() {
+    channel *ch = new channel(4);
+
+    std::thread consume([=]() {
+        context *root = root_context();
+        root->define("ch", ch);
+        eval(consumer(), root);
+    });
+
+    context *root = root_context();
+    root->define("ch", ch);
+    eval(producer(), root);
+
+    consume.join();
+    return 0;
+}
@@ -0,0 +1,36 @@
+
+#include <sic.hpp>
+
+#include <iostream>
+
+using namespace sic;
+
+// Load a prelude once and run several scripts in isolated forks of
+// it instead of building a new root context for each one.
+
+int main() {
+    context *root = root_context();
+    eval(read("(setq greeting \"hello, \")"), root);
+    eval(read("(defun greet (name) (concat greeting name))"), root);
+    root->freeze();
+
+    const char *scripts[] = {
+        "(greet \"world\")",
+        "(progn (setq greeting \"hi, \") (defun twice (x) (* 2 x)) (greet \"there\"))",
+        "(list (greet \"again\") greeting)",
+    };
+
+    for (const char *script : scripts) {
+        context *child = root->fork();
+        std::cout << script << " => "
+                  << printstr(eval(read(script), child)) << "\n";
+    }
+
+    try {
+        eval(read("(setq greeting \"changed\")"), root);
+    } catch (const frozen_context& e) {
+        std::cout << "root: " << e.msg() << "\n";
+    }
+
+    return 0;
+}
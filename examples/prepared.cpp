@@ -0,0 +1,36 @@
+
+#include <sic.hpp>
+
+#include <cstdio>
+
+using namespace sic;
+
+// Evaluate the same expressions many times from C++ without
+// rebuilding or re-expanding them.
+
+int main() {
+    context *root = root_context();
+
+    // Built with the $() templates...
+    static const prepared hypot2(root, {"x", "y"},
+                                 $(add, $(mul, $$("x"), $$("x")),
+                                        $(mul, $$("y"), $$("y"))));
+
+    // ...or parsed from text.
+    static const prepared classify(root, {"n"},
+                                   "(cond ((< n 0) 'negative)"
+                                   "      ((== n 0) 'zero)"
+                                   "      (t 'positive))");
+
+    double total = 0;
+    for (long i = 0; i < 100000; ++i) {
+        total += dca<number>(hypot2(i % 10, 2.5))->val;
+    }
+    printf("total = %g\n", total);
+
+    for (long n : {-5L, 0L, 5L}) {
+        printf("%ld is %s\n", n, printstr(classify(n)).c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Evaluation budgets.
+
+#include <algorithm>
+#include <climits>
+
+#include "sic.hpp"
+
+namespace sic {
+
+budget::budget() :
+    outer(active),
+    steps_left(outer ? outer->steps_left : UNLIMITED),
+    steps_used(0),
+    depth(0),
+    depth_limit(outer ? outer->depth_limit - outer->depth : UINT_MAX),
+    deadline(outer ? outer->deadline : clock::time_point::max()),
+    memory_limit(outer ? outer->memory_limit : UNLIMITED),
+    cancelled(nullptr),
+    until_check(CHECK_INTERVAL)
+{
+    active = this;
+}// budget
+
+
+budget::~budget() {
+    active = outer;
+    if (outer) {
+        outer->steps_left -= std::min(steps_used, outer->steps_left);
+        outer->steps_used += steps_used;
+    }
+}// ~budget
+
+
+budget&
+budget::steps(uint64_t n) {
+    steps_left = std::min(steps_left, n);
+    return *this;
+}// steps
+
+
+budget&
+budget::max_depth(unsigned n) {
+    depth_limit = std::min(depth_limit, depth + n);
+    return *this;
+}// max_depth
+
+
+budget&
+budget::timeout(clock::duration d) {
+    clock::time_point now = clock::now();
+    if (d < deadline - now) { deadline = now + d; }
+    return *this;
+}// timeout
+
+
+budget&
+budget::memory(uint64_t bytes) {
+    uint64_t now = heap_stats::allocated();
+    if (bytes < memory_limit - std::min(memory_limit, now)) {
+        memory_limit = now + bytes;
+    }
+    return *this;
+}// memory
+
+
+budget&
+budget::cancel_flag(const std::atomic<bool> *flag) {
+    cancelled = flag;
+    return *this;
+}// cancel_flag
+
+
+// The checks that are too slow to do on every step.
+void
+budget::check() {
+    until_check = CHECK_INTERVAL;
+
+    if (heap_stats::allocated() > memory_limit) {
+        throw budget_exceeded("memory limit reached");
+    }
+
+    for (budget *b = this; b; b = b->outer) {
+        if (b->cancelled && b->cancelled->load(std::memory_order_relaxed)) {
+            throw budget_exceeded("cancelled");
+        }
+    }
+
+    if (deadline != clock::time_point::max() && clock::now() > deadline) {
+        throw budget_exceeded("deadline passed");
+    }
+}// check
+
+}// namespace sic
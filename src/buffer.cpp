@@ -0,0 +1,87 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Foreign buffers: host arrays that Sic can read in place.
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "sic.hpp"
+
+namespace sic {
+
+// Read the element at 'p' as a double.  We memcpy rather than cast
+// because a slice (or the host) may hand us unaligned memory.
+template<typename T>
+static double
+load_element(const char *p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return (double)v;
+}// load_element
+
+
+double
+foreign_buffer::value(std::size_t i) const {
+    const char *p = data + i * type_size(elem);
+
+    switch (elem) {
+    case INT8:      return load_element<int8_t>(p);
+    case UINT8:     return load_element<uint8_t>(p);
+    case INT16:     return load_element<int16_t>(p);
+    case UINT16:    return load_element<uint16_t>(p);
+    case INT32:     return load_element<int32_t>(p);
+    case UINT32:    return load_element<uint32_t>(p);
+    case INT64:     return load_element<int64_t>(p);
+    case UINT64:    return load_element<uint64_t>(p);
+    case FLOAT:     return load_element<float>(p);
+    case DOUBLE:    return load_element<double>(p);
+    }
+
+    return 0;       // Not reached
+}// value
+
+
+obj *
+foreign_buffer::at(long i) const {
+    if (i < 0 || (std::size_t)i >= length) { return nil; }
+    return new number(value((std::size_t)i));
+}// at
+
+
+foreign_buffer *
+foreign_buffer::slice(long from, long to) const {
+    long len = (long)length;
+    from = std::clamp(from, 0L, len);
+    to = std::clamp(to, from, len);
+
+    return new foreign_buffer(keeper, data + from * type_size(elem),
+                              (std::size_t)(to - from), elem);
+}// slice
+
+
+const char *
+foreign_buffer::type_name(element e) {
+    static const char * const names[] = {
+        "i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64", "f32", "f64"
+    };
+    return names[e];
+}// type_name
+
+
+std::size_t
+foreign_buffer::type_size(element e) {
+    static const std::size_t sizes[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+    return sizes[e];
+}// type_size
+
+
+std::string
+foreign_buffer::str() const {
+    return std::string("<buffer ") + type_name(elem) + "["
+        + std::to_string(length) + "]>";
+}// str
+
+
+}// namespace sic
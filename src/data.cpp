@@ -0,0 +1,475 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// JSON and CSV.
+//
+// The readers work straight from a streambuf, a character at a time,
+// so they can stream values or rows out of files of any size.  JSON
+// values map onto Sic values like this:
+//
+//   number                 number
+//   string                 string
+//   true, false, null      the symbols t, false and null
+//   array                  list (so [] is nil)
+//   object                 (object (key value) ...), where each key
+//                          is a string
+//
+// and the writer does the reverse (with other symbols written as
+// strings).  CSV rows are lists of strings.
+//
+// Note that since only nil is false in Sic, JSON false and null come
+// out as TRUE values.  We don't map them to nil because then they
+// couldn't be told apart from [] or each other, and the writer
+// couldn't give back the original JSON.
+
+#include <string>
+#include <vector>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "sic.hpp"
+
+namespace sic {
+
+// Functions rather than globals so they don't depend on the order in
+// which statics get initialized.
+static symbol *object_sym() {
+    static symbol * const sym = symbol::intern("object");
+    return sym;
+}
+static symbol *false_sym() {
+    static symbol * const sym = symbol::intern("false");
+    return sym;
+}
+static symbol *null_sym() {
+    static symbol * const sym = symbol::intern("null");
+    return sym;
+}
+
+namespace {
+
+// A streambuf that reads from memory we don't own.
+class view_buf : public std::streambuf {
+public:
+    explicit view_buf(std::string_view text) {
+        char *p = const_cast<char*>(text.data());   // We never write
+        setg(p, p, p + text.size());
+    }
+};
+
+}// namespace
+
+
+//
+// JSON reader
+//
+
+namespace {
+
+class json_reader {
+    static constexpr int max_depth = 10000;    // Guards the C++ stack
+
+    std::streambuf *in;
+    std::size_t pos = 0;            // For error messages
+    int depth = 0;
+    std::string scratch;
+
+    int peek()  { return in->sgetc(); }
+    int next()  { ++pos; return in->sbumpc(); }
+
+    [[noreturn]] void fail(const std::string& what) {
+        throw syntax_error("JSON: " + what + " at byte " + std::to_string(pos));
+    }
+
+    void skip_space() {
+        while (true) {
+            int c = peek();
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') { return; }
+            next();
+        }
+    }
+
+    void expect(char c) {
+        skip_space();
+        if (next() != c) { fail(std::string("expecting '") + c + "'"); }
+    }
+
+    void expect_word(const char *word) {
+        for (const char *w = word; *w; ++w) {
+            if (next() != *w) { fail("bad literal"); }
+        }
+    }
+
+    unsigned hex4() {
+        unsigned value = 0;
+        for (int i = 0; i < 4; ++i) {
+            int c = next();
+            value <<= 4;
+            if (c >= '0' && c <= '9')       { value |= c - '0'; }
+            else if (c >= 'a' && c <= 'f')  { value |= c - 'a' + 10; }
+            else if (c >= 'A' && c <= 'F')  { value |= c - 'A' + 10; }
+            else { fail("bad \\u escape"); }
+        }
+        return value;
+    }
+
+    void put_utf8(std::string& s, unsigned cp) {
+        if (cp < 0x80) {
+            s += (char)cp;
+        } else if (cp < 0x800) {
+            s += (char)(0xC0 | (cp >> 6));
+            s += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            s += (char)(0xE0 | (cp >> 12));
+            s += (char)(0x80 | ((cp >> 6) & 0x3F));
+            s += (char)(0x80 | (cp & 0x3F));
+        } else {
+            s += (char)(0xF0 | (cp >> 18));
+            s += (char)(0x80 | ((cp >> 12) & 0x3F));
+            s += (char)(0x80 | ((cp >> 6) & 0x3F));
+            s += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // Read a string after its opening quote.
+    std::string read_string() {
+        std::string s;
+        while (true) {
+            int c = next();
+            if (c == '"') { return s; }
+            if (c == EOF) { fail("unterminated string"); }
+            if (c != '\\') { s += (char)c; continue; }
+
+            switch (c = next()) {
+            case '"': case '\\': case '/':  s += (char)c; break;
+            case 'b':   s += '\b'; break;
+            case 'f':   s += '\f'; break;
+            case 'n':   s += '\n'; break;
+            case 'r':   s += '\r'; break;
+            case 't':   s += '\t'; break;
+            case 'u': {
+                unsigned cp = hex4();
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    if (next() != '\\' || next() != 'u') {
+                        fail("unpaired surrogate");
+                    }
+                    unsigned low = hex4();
+                    if (low < 0xDC00 || low >= 0xE000) {
+                        fail("unpaired surrogate");
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                put_utf8(s, cp);
+                break;
+            }
+            default:
+                fail("bad escape");
+            }// switch
+        }// while
+    }
+
+    obj *read_number() {
+        scratch.clear();
+        while (true) {
+            int c = peek();
+            if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+                  c == 'e' || c == 'E'))
+            {
+                break;
+            }
+            scratch += (char)next();
+        }
+
+        double value;
+        const char *end = scratch.data() + scratch.size();
+        auto [ptr, ec] = std::from_chars(scratch.data(), end, value);
+        if (ec != std::errc() || ptr != end) { fail("bad number"); }
+        return new number(value);
+    }
+
+    obj *read_array() {
+        std::vector<obj*> items;
+        skip_space();
+        if (peek() == ']') { next(); return nil; }
+
+        while (true) {
+            items.push_back(read_value());
+            skip_space();
+            int c = next();
+            if (c == ']') { break; }
+            if (c != ',') { fail("expecting ',' or ']'"); }
+        }
+        return vec2list(items);
+    }
+
+    obj *read_object() {
+        std::vector<obj*> items = { object_sym() };
+        skip_space();
+        if (peek() == '}') { next(); return vec2list(items); }
+
+        while (true) {
+            expect('"');
+            obj *key = new string(read_string());
+            expect(':');
+            obj *value = read_value();
+            items.push_back(new pair(key, new pair(value, nil)));
+
+            skip_space();
+            int c = next();
+            if (c == '}') { break; }
+            if (c != ',') { fail("expecting ',' or '}'"); }
+        }
+        return vec2list(items);
+    }
+
+    // Read an array or object after its opening bracket.
+    template<typename Reader>
+    obj *nested(Reader read) {
+        if (++depth > max_depth) { fail("nested too deeply"); }
+        obj *value = read();
+        --depth;
+        return value;
+    }
+
+    obj *read_value() {
+        skip_space();
+        int c = peek();
+        switch (c) {
+        case '{':   next(); return nested([this]() { return read_object(); });
+        case '[':   next(); return nested([this]() { return read_array(); });
+        case '"':   next(); return new string(read_string());
+        case 't':   expect_word("true");    return t;
+        case 'f':   expect_word("false");   return false_sym();
+        case 'n':   expect_word("null");    return null_sym();
+        case EOF:   fail("unexpected end of input");
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) { return read_number(); }
+            fail(std::string("unexpected '") + (char)c + "'");
+        }
+    }
+
+public:
+    explicit json_reader(std::streambuf *sb) : in(sb) {}
+
+    obj *read() {
+        skip_space();
+        if (peek() == EOF) { return nullptr; }
+        return read_value();
+    }
+};
+
+}// namespace
+
+
+obj *
+read_json(std::streambuf *in) {
+    return json_reader(in).read();
+}// read_json
+
+
+obj *
+parse_json(std::string_view text) {
+    view_buf buf(text);
+    json_reader reader(&buf);
+
+    obj *value = reader.read();
+    if (!value) { throw syntax_error("JSON: no value"); }
+    if (reader.read()) { throw syntax_error("JSON: text after the value"); }
+    return value;
+}// parse_json
+
+
+
+//
+// JSON writer
+//
+
+static void
+write_json_string(std::string& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+
+    out += '"';
+    for (char ch : s) {
+        unsigned char c = (unsigned char)ch;
+        switch (c) {
+        case '"':   out += "\\\""; break;
+        case '\\':  out += "\\\\"; break;
+        case '\n':  out += "\\n"; break;
+        case '\r':  out += "\\r"; break;
+        case '\t':  out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+            } else {
+                out += ch;
+            }
+        }// switch
+    }
+    out += '"';
+}// write_json_string
+
+
+static void
+write_number(std::string& out, double val) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), val);
+    out.append(buf, ec == std::errc() ? end - buf : 0);
+}// write_number
+
+
+void
+write_json(std::string& out, obj *value) {
+    if (value == nil) { out += "[]"; return; }
+    if (value == t) { out += "true"; return; }
+    if (value == false_sym()) { out += "false"; return; }
+    if (value == null_sym()) { out += "null"; return; }
+
+    if (number *num = dynamic_cast<number*>(value)) {
+        if (std::isfinite(num->val)) {
+            write_number(out, num->val);
+        } else {
+            out += "null";
+        }
+        return;
+    }
+
+    if (string *str = dynamic_cast<string*>(value)) {
+        write_json_string(out, str->contents);
+        return;
+    }
+
+    if (value->isSymbol()) {
+        write_json_string(out, dynamic_cast<symbol*>(value)->text);
+        return;
+    }
+
+    if (!value->isList()) {
+        throw wrong_type("a value that can be written as JSON",
+                         printstr(value));
+    }
+
+    pair *list = static_cast<pair*>(value);
+    if (list->first == object_sym()) {
+        out += '{';
+        bool first = true;
+        for (obj *c = list->rest; c != nil; c = static_cast<pair*>(c)->rest) {
+            pair *entry = dca<pair>(static_cast<pair*>(c)->first);
+            if (llen(entry) != 2) {
+                throw wrong_type("a (key value) list", printstr(entry));
+            }
+            if (!first) { out += ','; }
+            first = false;
+
+            obj *key = entry->first;
+            write_json_string(out, key->isString()
+                              ? std::string(dca<string>(key)->contents)
+                              : printstr(key));
+            out += ':';
+            write_json(out, dca<pair>(entry->rest)->first);
+        }
+        out += '}';
+        return;
+    }
+
+    out += '[';
+    for (obj *c = list; c != nil; c = static_cast<pair*>(c)->rest) {
+        if (c != list) { out += ','; }
+        write_json(out, static_cast<pair*>(c)->first);
+    }
+    out += ']';
+}// write_json
+
+
+
+//
+// CSV
+//
+
+obj *
+read_csv_row(std::streambuf *in, char sep) {
+    if (in->sgetc() == EOF) { return nullptr; }
+
+    std::vector<obj*> fields;
+    std::string field;
+
+    while (true) {
+        int c = in->sbumpc();
+
+        if (c == '"' && field.empty()) {
+            // Quoted field; "" is a quote and anything else goes.
+            while (true) {
+                c = in->sbumpc();
+                if (c == EOF) { throw syntax_error("CSV: unterminated quote"); }
+                if (c == '"') {
+                    if (in->sgetc() != '"') { break; }
+                    in->sbumpc();
+                }
+                field += (char)c;
+            }
+            c = in->sbumpc();
+        }
+
+        if (c == sep) {
+            fields.push_back(new string(field));
+            field.clear();
+            continue;
+        }
+
+        if (c == '\n' || c == '\r' || c == EOF) {
+            if (c == '\r' && in->sgetc() == '\n') { in->sbumpc(); }
+            fields.push_back(new string(field));
+            return vec2list(fields);
+        }
+
+        field += (char)c;
+    }// while
+}// read_csv_row
+
+
+obj *
+parse_csv(std::string_view text, char sep) {
+    view_buf buf(text);
+    std::vector<obj*> rows;
+    for (obj *row = read_csv_row(&buf, sep); row; row = read_csv_row(&buf, sep)) {
+        rows.push_back(row);
+    }
+    return vec2list(rows);
+}// parse_csv
+
+
+void
+write_csv_row(std::string& out, obj *row, char sep) {
+    bool first = true;
+    basic_each(row, [&](obj *item) {
+            if (!first) { out += sep; }
+            first = false;
+
+            std::string text;
+            if (number *num = dynamic_cast<number*>(item)) {
+                write_number(text, num->val);
+            } else {
+                text = item == nil ? "" : printstr(item);
+            }
+
+            if (text.find_first_of(std::string("\"\r\n") + sep)
+                == std::string::npos)
+            {
+                out += text;
+                return;
+            }
+
+            out += '"';
+            for (char c : text) {
+                if (c == '"') { out += '"'; }
+                out += c;
+            }
+            out += '"';
+        });
+    out += '\n';
+}// write_csv_row
+
+
+}// namespace sic
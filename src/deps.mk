@@ -0,0 +1,16 @@
+sic.o: sic.cpp sic.hpp sic_func.inc
+port.o: port.cpp sic.hpp sic_func.inc
+image.o: image.cpp sic.hpp sic_func.inc
+module.o: module.cpp sic.hpp sic_func.inc
+profile.o: profile.cpp sic.hpp sic_func.inc
+heap.o: heap.cpp sic.hpp sic_func.inc
+trace.o: trace.cpp sic.hpp sic_func.inc
+prepared.o: prepared.cpp sic.hpp sic_func.inc
+buffer.o: buffer.cpp sic.hpp sic_func.inc
+sequence.o: sequence.cpp sic.hpp sic_func.inc
+memo.o: memo.cpp sic.hpp sic_func.inc
+budget.o: budget.cpp sic.hpp sic_func.inc
+data.o: data.cpp sic.hpp sic_func.inc
+repl.o: repl.cpp sic.hpp sic_func.inc unit.hpp server.hpp
+unit.o: unit.cpp unit.hpp sic.hpp sic_func.inc
+server.o: server.cpp server.hpp sic.hpp sic_func.inc
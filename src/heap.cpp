@@ -0,0 +1,113 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Allocation accounting.  See class heap_stats in sic.hpp.
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+
+#include "sic.hpp"
+
+namespace sic {
+
+// Counters for each function that has been called on this thread, in
+// order of first call.
+static thread_local
+std::vector<std::pair<const callable*, std::unique_ptr<heap_stats::counts>>>
+    sites;
+
+// The same counters by function.
+static thread_local
+std::unordered_map<const callable*, heap_stats::counts*> site_index;
+
+
+heap_stats::counts *
+heap_stats::lookup(const callable *fn) {
+    auto found = site_index.find(fn);
+    if (found != site_index.end()) { return found->second; }
+
+    sites.push_back({fn, std::make_unique<counts>()});
+    counts *c = sites.back().second.get();
+    site_index.emplace(fn, c);
+    return c;
+}// lookup
+
+
+std::vector<std::pair<const callable*, const heap_stats::counts*>>
+heap_stats::all() {
+    std::vector<std::pair<const callable*, const counts*>> result;
+    result.push_back({nullptr, &toplevel});
+    for (const auto& site : sites) {
+        result.push_back({site.first, site.second.get()});
+    }
+    return result;
+}// all
+
+
+const char *
+heap_stats::kind_name(kind k) {
+    static const char * const names[KINDS] = {
+        "pair", "number", "string", "context", "function"
+    };
+    return names[k];
+}// kind_name
+
+
+static uint64_t
+total_bytes(const heap_stats::counts& c) {
+    uint64_t total = 0;
+    for (int k = 0; k < heap_stats::KINDS; ++k) { total += c.bytes[k]; }
+    return total;
+}// total_bytes
+
+
+void
+heap_stats::report(std::ostream& out, const context *ctx) {
+    auto rows = all();
+    std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return total_bytes(*a.second) > total_bytes(*b.second);
+        });
+
+    counts sum = {};
+    for (const auto& row : rows) {
+        for (int k = 0; k < KINDS; ++k) {
+            sum.objects[k] += row.second->objects[k];
+            sum.bytes[k] += row.second->bytes[k];
+        }
+    }
+
+    char field[64];
+    out << "Allocations (objects / bytes):\n";
+    for (int k = 0; k < KINDS; ++k) {
+        snprintf(field, sizeof(field), "%20s", kind_name((kind)k));
+        out << field;
+    }
+    out << "         total  name\n";
+
+    auto line = [&](const counts& c, const std::string& name) {
+        if (total_bytes(c) == 0) { return; }
+
+        for (int k = 0; k < KINDS; ++k) {
+            snprintf(field, sizeof(field), "%9llu /%9llu",
+                     (unsigned long long)c.objects[k],
+                     (unsigned long long)c.bytes[k]);
+            out << field;
+        }
+        snprintf(field, sizeof(field), "%14llu  ",
+                 (unsigned long long)total_bytes(c));
+        out << field << name << "\n";
+    };
+
+    for (const auto& row : rows) {
+        line(*row.second,
+             row.first ? callable_name(row.first, ctx) : "<toplevel>");
+    }
+    line(sum, "<total>");
+}// report
+
+
+}// namespace sic
@@ -0,0 +1,802 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Heap images: a compact binary dump of a root context and everything
+// reachable from it.  Single values (along with whatever they refer
+// to) use the same format; that's what `serialize` and module caches
+// use.
+//
+// An image is a sequence of records, one per object, ordered so that
+// each object comes after everything needed to construct it (a pair's
+// first and rest, a function's formals, body and scope, a context's
+// parent).  Context bindings can refer to anything, so they're kept
+// in a separate section that is applied once every object exists;
+// this is what lets closures refer to themselves.
+//
+// Layout (all integers are unsigned LEB128 varints):
+//
+//   magic       "SICIMG2\n"
+//   symbols     count, then (length, bytes) for each name
+//   records     (tag, payload) ... T_END
+//   bindings    count, then for each context: id, count and
+//               (symbol index, object id) pairs
+//   value       id of the saved object
+//
+// Id 0 is nil and id 1 is the root context; records are numbered
+// from 2.  Inside records, references to other records are relative
+// (1 + the distance back from the record being read) so that the
+// common case, a reference to something just before, takes one byte.
+// Builtins are saved by name and the standard ports by number so
+// images don't depend on addresses in the binary.  Memoized functions
+// are saved without their caches.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+#include "sic.hpp"
+
+namespace sic {
+
+static const char magic[] = "SICIMG2\n";
+
+enum : unsigned char {
+    T_END = 0,
+    T_INT,          // Integral number: zigzag varint
+    T_DBL,          // Other number: 8 raw bytes
+    T_STR,          // Length, bytes
+    T_SYM,          // Symbol index
+    T_PAIR,         // First ref, rest ref
+    T_FUNC,         // Formals ref, body ref, scope ref, is-macro
+    T_BUILTIN,      // Symbol index of name
+    T_PORT,         // 0, 1, 2 for stdin, stdout, stderr
+    T_CTX,          // Parent ref (0 for none)
+    T_MEMO,         // Function ref, capacity (the cache isn't saved)
+    T_SEQ,          // Kind, then the kind's parts (see emit())
+};
+
+static const uint64_t NIL_ID = 0;
+static const uint64_t ROOT_ID = 1;
+static const uint64_t FIRST_ID = 2;
+static const uint64_t PENDING_ID = UINT64_MAX;    // Used while writing
+
+
+static void
+put_varint(std::string& out, uint64_t n) {
+    while (n >= 0x80) {
+        out += (char)((n & 0x7f) | 0x80);
+        n >>= 7;
+    }
+    out += (char)n;
+}// put_varint
+
+
+static void
+put_double(std::string& out, double d) {
+    char bytes[sizeof(double)];
+    memcpy(bytes, &d, sizeof(double));
+    out.append(bytes, sizeof(double));
+}// put_double
+
+
+// Names for builtins that can be saved (i.e. those in sic_func.inc).
+static const std::map<const obj*, std::string>&
+builtin_names() {
+    static const std::map<const obj*, std::string> names = []() {
+        std::map<const obj*, std::string> result;
+        for (const auto& item : builtin_table()) {
+            result[item.second] = item.first;
+        }
+        return result;
+    }();
+
+    return names;
+}// builtin_names
+
+
+//
+// Writing
+//
+
+// Object ids while writing.  This sees a lookup or two per object
+// written, so it's an open-addressed table rather than a
+// std::unordered_map (which spends most of its time chasing nodes).
+// Ids live in a deque so the slots we hand out stay put as the table
+// grows.
+class id_table {
+    struct entry { const void *key; uint64_t *slot; };
+
+    std::vector<entry> table;
+    std::deque<uint64_t> slots;
+
+    std::size_t home(const void *p) const {
+        uint64_t h = (uint64_t)(uintptr_t)p * 0x9E3779B97F4A7C15ull;
+        return (std::size_t)(h >> 32) & (table.size() - 1);
+    }
+
+    entry& find(const void *p) {
+        std::size_t i = home(p);
+        while (table[i].key && table[i].key != p) {
+            i = (i + 1) & (table.size() - 1);
+        }
+        return table[i];
+    }
+
+    void grow() {
+        std::vector<entry> old(table.size() * 2);
+        old.swap(table);
+        for (const entry& e : old) {
+            if (e.key) { find(e.key) = e; }
+        }
+    }
+
+public:
+    id_table() : table(1024) {}
+
+    // The slot for 'p', added (and set to 'initial') if it's new.
+    uint64_t *get(const void *p, uint64_t initial) {
+        entry& e = find(p);
+        if (e.key) { return e.slot; }
+
+        slots.push_back(initial);
+        e = { p, &slots.back() };
+        uint64_t *slot = e.slot;
+
+        if (slots.size() * 2 > table.size()) { grow(); }
+        return slot;
+    }
+
+    uint64_t at(const void *p) {
+        entry& e = find(p);
+        if (!e.key) { throw std::out_of_range("id_table::at"); }
+        return *e.slot;
+    }
+};
+
+
+class image_writer {
+    context * const root;
+    const bool include_root;
+
+    id_table ids;
+    uint64_t next_id;
+
+    std::map<std::string, uint64_t, std::less<>> sym_ids;
+    std::vector<std::string_view> syms;
+
+    std::string records;
+    std::vector<const context*> contexts;
+
+    uint64_t sym(std::string_view name);
+    uint64_t id(const void *p) { return ids.at(p); }
+    // A reference from the record being written; 'slot' holds the
+    // id.
+    uint64_t ref(const uint64_t *slot) const {
+        return *slot < FIRST_ID ? *slot : next_id - *slot + 1;
+    }
+
+    void visit(const void *start, bool is_ctx);
+    void emit(obj *o, uint64_t * const kids[]);
+    void emit(const context *c, uint64_t * const kids[]);
+    void visit_bindings();
+
+public:
+    image_writer(context *r, bool incroot) :
+        root(r), include_root(incroot), next_id(FIRST_ID)
+    {
+        ids.get(nil, NIL_ID);
+
+        // A fork is saved as one context with everything it inherits,
+        // so the contexts it forked are also the root.
+        for (const context *c = root; c; c = c->forked_from()) {
+            ids.get(c, ROOT_ID);
+        }
+    }
+
+    std::string write(obj *value);
+    std::string write_root();
+
+private:
+    std::string finish(uint64_t value_id);
+};
+
+
+uint64_t
+image_writer::sym(std::string_view name) {
+    auto found = sym_ids.find(name);
+    if (found != sym_ids.end()) { return found->second; }
+
+    uint64_t index = syms.size();
+    auto inserted = sym_ids.emplace(std::string(name), index);
+    syms.push_back(inserted.first->first);
+    return index;
+}// sym
+
+
+// Depth-first traversal that emits each object after the objects it
+// depends on.  We use an explicit stack since lists can be long.
+//
+// Objects get a placeholder id when they're first pushed; emitting
+// one fills in the real id through the saved slot.  If we reach an
+// object that's still waiting on the stack, we push it again so it
+// gets emitted before whatever needs it (the older entry is then
+// skipped).  Pairs are immutable so this can't loop.
+//
+// Each entry also keeps the slots of the things it refers to (its
+// "kids") so that emitting it doesn't have to look them up again;
+// the table is by far the most expensive part of writing.
+void
+image_writer::visit(const void *start, bool is_ctx) {
+    struct item {
+        const void *p;
+        bool is_ctx;
+        bool expanded;
+        uint64_t *slot;
+        uint64_t *kids[3];
+    };
+    std::vector<item> stack;
+
+    auto push = [&](const void *p, bool ctx) -> uint64_t* {
+        if (!p) { return nullptr; }
+
+        uint64_t *slot = ids.get(p, PENDING_ID);
+        if (*slot == PENDING_ID) {
+            stack.push_back({p, ctx, false, slot, {}});
+        }
+        return slot;
+    };
+
+    push(start, is_ctx);
+    while (!stack.empty()) {
+        item curr = stack.back();
+        stack.pop_back();
+
+        if (*curr.slot != PENDING_ID) { continue; }    // Done already
+
+        if (curr.expanded) {
+            if (curr.is_ctx) {
+                emit((const context*)curr.p, curr.kids);
+            } else {
+                emit((obj*)curr.p, curr.kids);
+            }
+            *curr.slot = next_id++;
+            continue;
+        }
+
+        std::size_t self = stack.size();
+        stack.push_back({curr.p, curr.is_ctx, true, curr.slot, {}});
+
+        uint64_t *kids[3] = {};
+        if (curr.is_ctx) {
+            kids[0] = push(((const context*)curr.p)->parent, true);
+        } else if (pair *p = dynamic_cast<pair*>((obj*)curr.p)) {
+            kids[1] = push(p->rest, false);
+            kids[0] = push(p->first, false);
+        } else if (function *f = dynamic_cast<function*>((obj*)curr.p)) {
+            kids[2] = push(f->outer, true);
+            kids[1] = push(f->body, false);
+            kids[0] = push(f->formals, false);
+        } else if (memoized *m = dynamic_cast<memoized*>((obj*)curr.p)) {
+            kids[0] = push(m->wrapped(), false);
+        } else if (sequence *sq = dynamic_cast<sequence*>((obj*)curr.p)) {
+            sequence::parts parts = sq->describe();
+            kids[2] = push(parts.ctx, true);
+            kids[1] = push(parts.fn, false);
+            kids[0] = push(parts.source, false);
+        }
+        std::copy(kids, kids + 3, stack[self].kids);
+    }// while
+}// visit
+
+
+void
+image_writer::emit(obj *o, uint64_t * const kids[]) {
+    if (number *n = dynamic_cast<number*>(o)) {
+        double v = n->val;
+        if (v == trunc(v) && fabs(v) < 9007199254740992.0) {
+            int64_t i = (int64_t)v;
+            records += (char)T_INT;
+            put_varint(records, ((uint64_t)i << 1) ^ (uint64_t)(i >> 63));
+        } else {
+            records += (char)T_DBL;
+            put_double(records, v);
+        }
+    } else if (string *s = dynamic_cast<string*>(o)) {
+        records += (char)T_STR;
+        put_varint(records, s->contents.size());
+        records += s->contents;
+    } else if (symbol *sy = dynamic_cast<symbol*>(o)) {
+        records += (char)T_SYM;
+        put_varint(records, sym(sy->text));
+    } else if (dynamic_cast<pair*>(o)) {
+        records += (char)T_PAIR;
+        put_varint(records, ref(kids[0]));
+        put_varint(records, ref(kids[1]));
+    } else if (function *f = dynamic_cast<function*>(o)) {
+        records += (char)T_FUNC;
+        put_varint(records, ref(kids[0]));
+        put_varint(records, ref(kids[1]));
+        put_varint(records, ref(kids[2]));
+        put_varint(records, f->isMacro ? 1 : 0);
+    } else if (builtin_names().count(o)) {
+        records += (char)T_BUILTIN;
+        put_varint(records, sym(builtin_names().at(o)));
+    } else if (o == stdin_port() || o == stdout_port() || o == stderr_port()) {
+        records += (char)T_PORT;
+        put_varint(records,
+                   o == stdin_port() ? 0 : o == stdout_port() ? 1 : 2);
+    } else if (memoized *m = dynamic_cast<memoized*>(o)) {
+        records += (char)T_MEMO;
+        put_varint(records, ref(kids[0]));
+        put_varint(records, m->max_size());
+    } else if (sequence *sq = dynamic_cast<sequence*>(o)) {
+        // A range is its three numbers; every other kind starts with
+        // its source, and map and filter add their function and
+        // context and take and drop their count.
+        sequence::parts parts = sq->describe();
+        records += (char)T_SEQ;
+        records += (char)parts.kind;
+        switch (parts.kind) {
+        case sequence::parts::RANGE:
+            put_double(records, parts.start);
+            put_double(records, parts.end);
+            put_double(records, parts.step);
+            break;
+        case sequence::parts::MAP:
+        case sequence::parts::FILTER:
+            put_varint(records, ref(kids[0]));
+            put_varint(records, ref(kids[1]));
+            put_varint(records, ref(kids[2]));
+            break;
+        case sequence::parts::TAKE:
+        case sequence::parts::DROP:
+            put_varint(records, ref(kids[0]));
+            put_varint(records, parts.count);
+            break;
+        default:
+            put_varint(records, ref(kids[0]));
+        }
+    } else {
+        throw wrong_type("a value that can be saved", printstr(o));
+    }
+}// emit
+
+
+void
+image_writer::emit(const context *c, uint64_t * const kids[]) {
+    records += (char)T_CTX;
+    put_varint(records, c->parent ? ref(kids[0]) : 0);
+
+    contexts.push_back(c);
+}// emit
+
+
+// True if 'o' is a builtin supplied by the host program rather than
+// sic_func.inc (e.g. the unit-test functions).  These are left out
+// of the root context's bindings since the host will provide them
+// again.
+static bool
+is_host_builtin(obj *o) {
+    return dynamic_cast<builtin*>(o) && builtin_names().count(o) == 0;
+}// is_host_builtin
+
+
+// Visit every object reachable from the bindings of the contexts
+// we've seen so far.  This can discover more contexts, which we then
+// also visit.
+void
+image_writer::visit_bindings() {
+    if (include_root) {
+        for (const auto& item : root->all_bindings()) {
+            if (is_host_builtin(item.second)) { continue; }
+            visit(item.second, false);
+        }
+    }
+
+    for (std::size_t i = 0; i < contexts.size(); ++i) {
+        for (const auto& item : contexts[i]->all_bindings()) {
+            visit(item.second, false);
+        }
+    }
+}// visit_bindings
+
+
+std::string
+image_writer::finish(uint64_t value_id) {
+    records += (char)T_END;
+
+    auto saved = [&](const context *c, obj *value) {
+        return c != root || !is_host_builtin(value);
+    };
+
+    // Make sure the binding names are in the symbol table before we
+    // write it out.
+    struct scope {
+        const context *c;
+        uint64_t id;
+        std::map<std::string, obj*> bindings;
+    };
+    std::vector<scope> scopes;
+    if (include_root) {
+        scopes.push_back({root, ROOT_ID, root->all_bindings()});
+    }
+    for (const context *c : contexts) {
+        scopes.push_back({c, id(c), c->all_bindings()});
+    }
+
+    for (const auto& scope : scopes) {
+        for (const auto& item : scope.bindings) { sym(item.first); }
+    }
+
+    std::string out(magic);
+
+    put_varint(out, syms.size());
+    for (std::string_view s : syms) {
+        put_varint(out, s.size());
+        out += s;
+    }
+
+    out += records;
+
+    put_varint(out, scopes.size());
+    for (const auto& scope : scopes) {
+        const context *c = scope.c;
+
+        uint64_t count = 0;
+        for (const auto& item : scope.bindings) {
+            if (saved(c, item.second)) { ++count; }
+        }
+
+        put_varint(out, scope.id);
+        put_varint(out, count);
+        for (const auto& item : scope.bindings) {
+            if (!saved(c, item.second)) { continue; }
+            put_varint(out, sym(item.first));
+            put_varint(out, id(item.second));
+        }
+    }// for
+
+    put_varint(out, value_id);
+    return out;
+}// finish
+
+
+std::string
+image_writer::write(obj *value) {
+    visit(value, false);
+    visit_bindings();
+    return finish(id(value));
+}// write
+
+
+std::string
+image_writer::write_root() {
+    visit_bindings();
+    return finish(ROOT_ID);
+}// write_root
+
+
+
+//
+// Reading
+//
+
+class image_reader {
+    const unsigned char *pos;
+    const unsigned char * const end;
+    context * const root;
+
+    std::vector<std::string_view> syms;
+
+    // Objects and contexts by id; exactly one of each pair is set.
+    std::vector<obj*> objs;
+    std::vector<context*> ctxs;
+
+    [[noreturn]] void corrupt() const {
+        throw io_error("Corrupt or incompatible image.");
+    }
+
+    uint64_t varint();
+    std::string_view bytes(uint64_t len);
+    double dbl() {
+        double d;
+        memcpy(&d, bytes(sizeof(double)).data(), sizeof(double));
+        return d;
+    }
+    std::string_view symbol_name() {
+        uint64_t i = varint();
+        if (i >= syms.size()) { corrupt(); }
+        return syms[i];
+    }
+
+    void add(obj *o, context *c) {
+        objs.push_back(o);
+        ctxs.push_back(c);
+    }
+
+    // Turn a reference inside a record into an id.
+    uint64_t ref() {
+        uint64_t r = varint();
+        if (r < FIRST_ID) { return r; }
+        if (r - 1 > objs.size() - FIRST_ID) { corrupt(); }
+        return objs.size() - (r - 1);
+    }
+
+    obj *object(uint64_t id) const {
+        if (id >= objs.size() || !objs[id]) { corrupt(); }
+        return objs[id];
+    }
+
+    context *scope(uint64_t id) const {
+        if (id >= ctxs.size() || !ctxs[id]) { corrupt(); }
+        return ctxs[id];
+    }
+
+    void read_record(unsigned char tag);
+
+public:
+    image_reader(std::string_view data, context *r) :
+        pos((const unsigned char *)data.data()),
+        end((const unsigned char *)data.data() + data.size()),
+        root(r)
+    {
+        add(nil, nullptr);
+        add(nullptr, root);
+    }
+
+    // Returns the saved value (nullptr if it was the root context).
+    obj *read();
+};
+
+
+uint64_t
+image_reader::varint() {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= end) { corrupt(); }
+
+        unsigned char b = *pos++;
+        result |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) { return result; }
+    }
+
+    corrupt();
+}// varint
+
+
+std::string_view
+image_reader::bytes(uint64_t len) {
+    if ((uint64_t)(end - pos) < len) { corrupt(); }
+
+    std::string_view result((const char *)pos, len);
+    pos += len;
+    return result;
+}// bytes
+
+
+void
+image_reader::read_record(unsigned char tag) {
+    switch (tag) {
+    case T_INT: {
+        uint64_t z = varint();
+        int64_t i = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+        add(new number((double)i), nullptr);
+        break;
+    }
+
+    case T_DBL:
+        add(new number(dbl()), nullptr);
+        break;
+
+    case T_STR:
+        add(new string(std::string(bytes(varint()))), nullptr);
+        break;
+
+    case T_SYM:
+        add(symbol::intern(symbol_name()), nullptr);
+        break;
+
+    case T_PAIR: {
+        obj *first = object(ref());
+        obj *rest = object(ref());
+        add(new pair(first, rest), nullptr);
+        break;
+    }
+
+    case T_FUNC: {
+        pair *formals = dca<pair>(object(ref()));
+        pair *body = dca<pair>(object(ref()));
+        context *outer = scope(ref());
+        bool isMacro = varint() != 0;
+        add(new function(formals, body, outer, isMacro), nullptr);
+        break;
+    }
+
+    case T_BUILTIN: {
+        std::string_view name = symbol_name();
+        auto found = builtin_table().find(std::string(name));
+        if (found == builtin_table().end()) {
+            throw io_error("Image refers to unknown builtin '" +
+                           std::string(name) + "'.");
+        }
+        add(found->second, nullptr);
+        break;
+    }
+
+    case T_PORT: {
+        uint64_t n = varint();
+        if (n > 2) { corrupt(); }
+        add(n == 0 ? (obj*)stdin_port()
+            : n == 1 ? (obj*)stdout_port()
+            : (obj*)stderr_port(),
+            nullptr);
+        break;
+    }
+
+    case T_CTX: {
+        uint64_t parent = ref();
+        add(nullptr, new context(parent ? scope(parent) : nullptr));
+        break;
+    }
+
+    case T_MEMO: {
+        callable *fn = dca<callable>(object(ref()));
+        add(new memoized(fn, (std::size_t)varint()), nullptr);
+        break;
+    }
+
+    case T_SEQ: {
+        if (pos >= end || *pos > sequence::parts::FORMS) { corrupt(); }
+
+        sequence::parts parts{(decltype(parts.kind))*pos++};
+        switch (parts.kind) {
+        case sequence::parts::RANGE:
+            parts.start = dbl();
+            parts.end = dbl();
+            parts.step = dbl();
+            break;
+        case sequence::parts::MAP:
+        case sequence::parts::FILTER:
+            parts.source = object(ref());
+            parts.fn = dca<callable>(object(ref()));
+            parts.ctx = scope(ref());
+            break;
+        case sequence::parts::TAKE:
+        case sequence::parts::DROP:
+            parts.source = object(ref());
+            parts.count = (std::size_t)varint();
+            break;
+        default:
+            parts.source = object(ref());
+        }
+        add(sequence::rebuild(parts), nullptr);
+        break;
+    }
+
+    default:
+        corrupt();
+    }// switch
+}// read_record
+
+
+obj *
+image_reader::read() {
+    if (bytes(sizeof(magic) - 1) != std::string_view(magic)) { corrupt(); }
+
+    for (uint64_t n = varint(); n > 0; --n) {
+        syms.push_back(bytes(varint()));
+    }
+
+    while (true) {
+        if (pos >= end) { corrupt(); }
+
+        unsigned char tag = *pos++;
+        if (tag == T_END) { break; }
+
+        read_record(tag);
+    }// while
+
+    for (uint64_t n = varint(); n > 0; --n) {
+        uint64_t ctx_id = varint();
+        context *c = scope(ctx_id);
+
+        for (uint64_t count = varint(); count > 0; --count) {
+            std::string name(symbol_name());
+            obj *value = object(varint());
+
+            if (ctx_id == ROOT_ID) {
+                c->tl_set(name, value);
+            } else {
+                c->define(name, value);
+            }
+        }// for
+    }// for
+
+    uint64_t value_id = varint();
+    return value_id == ROOT_ID ? nullptr : object(value_id);
+}// read
+
+
+
+//
+// Values
+//
+
+// Encode 'value' and everything reachable from it.  Closures over
+// 'root' refer to it by id rather than including it.
+std::string
+encode_value(obj *value, context *root) {
+    return image_writer(root, false).write(value);
+}// encode_value
+
+
+// Decode a value written by encode_value(), reconnecting references
+// to the root context to 'root'.
+obj *
+decode_value(std::string_view data, context *root) {
+    obj *value = image_reader(data, root).read();
+    if (!value) { throw io_error("Corrupt or incompatible image."); }
+    return value;
+}// decode_value
+
+
+// Encode 'value' (as encode_value() does) into the file at 'path'.
+void
+save_value(const std::string& path, obj *value, context *root) {
+    std::string data = encode_value(value, root);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+    out.close();
+
+    if (!out) {
+        throw io_error("Unable to write '" + path + "'.");
+    }
+}// save_value
+
+
+// Decode the value saved by save_value() at 'path'.  The file is
+// mapped and decoded in place rather than read into memory first.
+obj *
+load_value(const std::string& path, context *root) {
+    mapped_file file(path);
+    return decode_value(file.text(), root);
+}// load_value
+
+
+
+//
+// Images
+//
+
+// Save 'root' and everything reachable from it to the file at
+// 'path'.
+void
+save_image(context *root, const std::string& path) {
+    std::string data = image_writer(root, true).write_root();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+    out.close();
+
+    if (!out) {
+        throw io_error("Unable to write image '" + path + "'.");
+    }
+}// save_image
+
+
+// Restore the image at 'path' into 'root', which should normally be
+// a fresh root context.  Saved globals replace existing ones.
+void
+load_image(context *root, const std::string& path) {
+    mapped_file image(path);
+    image_reader(image.text(), root).read();
+}// load_image
+
+
+}// namespace sic
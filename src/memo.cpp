@@ -0,0 +1,57 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Memoized callables.
+
+#include "sic.hpp"
+
+namespace sic {
+
+obj*
+memoized::call(obj* actualArgs, context* outer) const {
+    std::unique_lock<std::mutex> hold(lock);
+
+    auto found = index.find(actualArgs);
+    if (found != index.end()) {
+        ++hit_count;
+        lru.splice(lru.begin(), lru, found->second);
+        return found->second->second;
+    }
+
+    ++miss_count;
+
+    // Unlocked since 'fn' may call us again (or take a while).
+    hold.unlock();
+    obj *result = fn->call(actualArgs, outer);
+    hold.lock();
+
+    // A recursive call (or another thread) may have already stored
+    // this result.
+    found = index.find(actualArgs);
+    if (found != index.end()) {
+        found->second->second = result;
+        lru.splice(lru.begin(), lru, found->second);
+        return result;
+    }
+
+    lru.emplace_front(actualArgs, result);
+    index.emplace(actualArgs, lru.begin());
+
+    if (capacity > 0 && index.size() > capacity) {
+        index.erase(lru.back().first);
+        lru.pop_back();
+    }
+
+    return result;
+}// call
+
+
+void
+memoized::clear() {
+    std::lock_guard<std::mutex> hold(lock);
+    index.clear();
+    lru.clear();
+    hit_count = miss_count = 0;
+}// clear
+
+}// namespace sic
@@ -0,0 +1,416 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Modules: scripts loaded with `load` or `require`.
+//
+// Loading a module reads its top-level forms and macro-expands them
+// ahead of time before evaluating them.  The expanded forms are then
+// saved next to the source (foo.sic -> foo.sicc) so later loads can
+// skip both the reader and the expansion.
+//
+// A cache file is a fixed header followed by the forms encoded with
+// encode_value():
+//
+//   magic       "SICMOD2\n"
+//   mtime       seconds, nanoseconds   (uint64_t each, native order)
+//   size        source length in bytes
+//   hash        FNV-1a hash of the source
+//
+// The cache is used if the source's mtime and size match or, failing
+// that, if its hash does.  Anything else (including a cache the
+// current build can't decode) is quietly ignored and rewritten.
+//
+// An expansion also depends on the macros it used, which may come
+// from other modules, so each cached form is stored along with the
+// name and a hash of every macro written in Sic that its expansion
+// called: '(form (name . hash) ...)'.  Before a cached form is
+// evaluated these are checked against the current definitions; if
+// one has changed, the rest of the module is expanded from source
+// again (the forms before it are unaffected) and the cache rewritten.
+// (A name that wasn't a macro at all when the module was cached but
+// is one now isn't noticed.)
+
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sic.hpp"
+
+namespace sic {
+
+static const char magic[] = "SICMOD2\n";
+
+struct cache_header {
+    char magic[sizeof(sic::magic) - 1];
+    uint64_t mtime_sec, mtime_nsec;
+    uint64_t size;
+    uint64_t hash;
+};
+
+
+//
+// Expansion
+//
+
+// Builtin macros that only rewrite their arguments and so can safely
+// be expanded ahead of time.  'start' says where the arguments that
+// get evaluated start; for `cond`, each argument is a clause whose
+// items are all evaluated.  'binds' is the argument holding the names
+// the macro binds (formals or `let` locals), or -1.
+struct pure_macro {
+    int start, binds;
+};
+
+static const std::map<const obj*, pure_macro>&
+pure_macros() {
+    static const std::map<const obj*, pure_macro> macros = []() {
+        const std::map<std::string, pure_macro> names = {
+            {"lambda", {1, 0}}, {"fun", {1, 0}}, {"macro", {1, 0}},
+            {"defun", {2, 1}}, {"defmacro", {2, 1}}, {"defun-memo", {2, 1}},
+            {"if", {0, -1}}, {"or", {0, -1}}, {"and", {0, -1}},
+            {"setq", {1, -1}}, {"let", {1, 0}}, {"cond", {-1, -1}},
+        };
+
+        std::map<const obj*, pure_macro> result;
+        for (const auto& item : names) {
+            result[builtin_table().at(item.first)] = item.second;
+        }
+        return result;
+    }();
+
+    return macros;
+}// pure_macros
+
+
+// Look up 'name' without throwing; returns nullptr if it's undefined.
+static obj *
+lookup(context *ctx, const std::string& name) {
+    for (context *c = ctx; c; c = c->parent) {
+        if (c->has(name)) { return c->get(name); }
+    }
+    return nullptr;
+}// lookup
+
+
+// The state of one expansion: the context macros are looked up in,
+// the local names in scope at the current point (which hide any
+// global macro of the same name) and, if wanted, the macros written
+// in Sic that were expanded.
+struct expansion {
+    context * const ctx;
+    std::set<std::string> bound;
+    std::map<std::string, const function*> *used;
+
+    obj *expand(obj *expr);
+    obj *expand_from(obj *list, int start);
+    obj *expand_macro_args(obj *args, const pure_macro& how);
+};
+
+
+// Expand each item in 'list' from index 'start' on.
+obj *
+expansion::expand_from(obj *list, int start) {
+    std::vector<obj*> items;
+    int n = 0;
+    for (obj *c = list; c != nil; c = dca<pair>(c)->rest, ++n) {
+        obj *item = dca<pair>(c)->first;
+        items.push_back(n >= start ? expand(item) : item);
+    }
+
+    return vec2list(items);
+}// expand_from
+
+
+// Add the names in a formal argument list or a `let` locals list
+// ('(a (b 1) c)' or just 'args') to 'names'.
+static void
+add_bound(obj *names, std::set<std::string>& bound) {
+    if (names->isSymbol()) {
+        bound.insert(dca<symbol>(names)->text);
+        return;
+    }
+    if (!names->isList()) { return; }
+
+    for (obj *c = names; c != nil && c->isList(); c = dca<pair>(c)->rest) {
+        obj *item = dca<pair>(c)->first;
+        if (item->isList() && item != nil) { item = dca<pair>(item)->first; }
+        if (item->isSymbol()) { bound.insert(dca<symbol>(item)->text); }
+    }
+}// add_bound
+
+
+// Expand the arguments of a pure macro call as described by 'how'
+// (see pure_macros()).
+obj *
+expansion::expand_macro_args(obj *args, const pure_macro& how) {
+    if (how.binds >= 0) {
+        obj *names = nil;
+        int n = 0;
+        for (obj *c = args; c != nil; c = dca<pair>(c)->rest, ++n) {
+            if (n == how.binds) { names = dca<pair>(c)->first; break; }
+        }
+
+        expansion inner{ctx, bound, used};
+        add_bound(names, inner.bound);
+        return inner.expand_from(args, how.start);
+    }
+
+    if (how.start >= 0) { return expand_from(args, how.start); }
+
+    return basic_map(
+        dca<pair>(args),
+        [this](obj *clause) -> obj* {
+            return clause->isList() ? expand_from(clause, 0) : clause;
+        });
+}// expand_macro_args
+
+
+obj *
+expansion::expand(obj *expr) {
+    static obj * const quote = builtin_table().at("quote");
+
+    if (expr == nil || !expr->isList()) { return expr; }
+
+    pair *pexpr = dca<pair>(expr);
+    obj *head = pexpr->first;
+
+    if (head == quote) { return expr; }
+    if (head->isList()) { return expand_from(expr, 0); }
+
+    // A call through a local variable is a function call whatever the
+    // global of that name is.
+    if (head->isSymbol() && bound.count(dca<symbol>(head)->text)) {
+        return new pair(head, expand_from(pexpr->rest, 0));
+    }
+
+    obj *fun = head->isSymbol() ? lookup(ctx, dca<symbol>(head)->text) : head;
+    if (!fun || !fun->isCallable()) { return expr; }
+
+    callable *cfun = dca<callable>(fun);
+    if (!cfun->isMacro) {
+        return new pair(head, expand_from(pexpr->rest, 0));
+    }
+
+    auto pure = pure_macros().find(fun);
+    if (pure != pure_macros().end()) {
+        return cfun->call(expand_macro_args(pexpr->rest, pure->second), ctx);
+    }
+
+    if (const function *macro = dynamic_cast<function*>(fun)) {
+        if (used && head->isSymbol()) {
+            (*used)[dca<symbol>(head)->text] = macro;
+        }
+        return expand(cfun->call(pexpr->rest, ctx));
+    }
+
+    return expr;
+}// expand
+
+
+// Expand 'expr' and note the Sic macros it used in 'used'.
+static obj *
+expand(obj *expr, context *ctx, std::map<std::string, const function*> *used) {
+    return expansion{ctx, {}, used}.expand(expr);
+}// expand
+
+
+// Macro-expand 'expr' as far as can be done without evaluating it.
+// Calls to the pure builtin macros and to macros defined in Sic are
+// expanded, as are the arguments of function calls.  Anything whose
+// meaning isn't known yet (undefined names, names bound by an
+// enclosing lambda or let, other builtin macros, quoted data) is left
+// as is.
+obj *
+expand(obj *expr, context *ctx) {
+    return expand(expr, ctx, nullptr);
+}// expand
+
+
+
+//
+// Cache files
+//
+
+static uint64_t
+fnv1a(std::string_view data) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}// fnv1a
+
+
+// Return the cached forms for a source file with header 'want', or
+// nullptr if the cache is missing or stale.
+static obj *
+read_cache(const std::string& cache_path, const cache_header& want,
+           const mapped_file& source, context *root) {
+    try {
+        mapped_file cache(cache_path);
+        std::string_view data = cache.text();
+
+        cache_header have;
+        if (data.size() < sizeof(have)) { return nullptr; }
+        memcpy(&have, data.data(), sizeof(have));
+
+        if (memcmp(have.magic, magic, sizeof(have.magic)) != 0 ||
+            have.size != want.size)
+        {
+            return nullptr;
+        }
+
+        bool same_time = have.mtime_sec == want.mtime_sec &&
+            have.mtime_nsec == want.mtime_nsec;
+        if (!same_time && have.hash != fnv1a(source.text())) {
+            return nullptr;
+        }
+
+        return decode_value(data.substr(sizeof(have)), root);
+    } catch (const error&) {
+        return nullptr;
+    }
+}// read_cache
+
+
+// Save 'forms' as the cache.  We write to a temporary file and
+// rename it so concurrent loaders never see a partial cache.  Failure
+// (e.g. a read-only directory) just means there's no cache.
+static void
+write_cache(const std::string& cache_path, cache_header header,
+            const mapped_file& source, obj *forms, context *root) {
+    try {
+        memcpy(header.magic, magic, sizeof(header.magic));
+        header.hash = fnv1a(source.text());
+
+        std::string data = encode_value(forms, root);
+
+        std::string tmp = cache_path + "." + std::to_string(getpid());
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write((const char *)&header, sizeof(header));
+        out.write(data.data(), data.size());
+        out.close();
+
+        if (!out || rename(tmp.c_str(), cache_path.c_str()) != 0) {
+            unlink(tmp.c_str());
+        }
+    } catch (const error&) {
+        // Not everything can be saved (e.g. a macro that expands to
+        // an open port); such modules just don't get cached.
+    }
+}// write_cache
+
+
+
+//
+// Loading
+//
+
+// A hash of 'macro' for checking that it's unchanged, or "" if it
+// can't be saved (and so can't be checked).
+static std::string
+fingerprint(const function *macro, context *root) {
+    try {
+        return std::to_string(fnv1a(encode_value((obj*)macro, root)));
+    } catch (const error&) {
+        return "";
+    }
+}// fingerprint
+
+
+// The list of (name . fingerprint) pairs for the cache entry of a form
+// that used 'macros'.
+static obj *
+macro_list(const std::map<std::string, const function*>& macros,
+           context *root) {
+    std::vector<obj*> items;
+    for (const auto& item : macros) {
+        items.push_back(new pair(symbol::intern(item.first),
+                                 new string(fingerprint(item.second, root))));
+    }
+    return vec2list(items);
+}// macro_list
+
+
+// Test if the macros in a cache entry's list are still defined as
+// they were.
+static bool
+macros_unchanged(obj *macros, context *root) {
+    for (obj *c = macros; c != nil; c = dca<pair>(c)->rest) {
+        pair *item = dca<pair>(dca<pair>(c)->first);
+        std::string_view want = dca<string>(item->rest)->contents;
+
+        obj *now = lookup(root, dca<symbol>(item->first)->text);
+        const function *macro = dynamic_cast<function*>(now);
+        if (want.empty() || !macro || !macro->isMacro ||
+            fingerprint(macro, root) != want)
+        {
+            return false;
+        }
+    }
+    return true;
+}// macros_unchanged
+
+
+// Load the script at 'path' into 'root', using and updating its
+// cache.  Returns the value of the last expression.
+obj *
+load_module(context *root, const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0) {
+        throw io_error("Unable to open '" + path + "': " + strerror(errno));
+    }
+
+    mapped_file source(path);
+    const std::string cache_path = path + "c";
+
+    cache_header header = {};
+    header.mtime_sec = (uint64_t)st.st_mtim.tv_sec;
+    header.mtime_nsec = (uint64_t)st.st_mtim.tv_nsec;
+    header.size = (uint64_t)st.st_size;
+
+    obj *result = nil;
+
+    // Cache entries for the forms evaluated so far.
+    std::vector<obj*> entries;
+
+    if (obj *cached = read_cache(cache_path, header, source, root)) {
+        obj *c = cached;
+        for (; c != nil; c = dca<pair>(c)->rest) {
+            pair *entry = dca<pair>(dca<pair>(c)->first);
+            if (!macros_unchanged(entry->rest, root)) { break; }
+
+            entries.push_back(entry);
+            result = eval(entry->first, root);
+        }
+        if (c == nil) { return result; }
+    }
+
+    // Each form is expanded just before it's evaluated so that it can
+    // use macros defined earlier in the file.  We skip any that were
+    // already run from the cache.
+    buffer_reader reader(source.text());
+    std::size_t done = entries.size();
+    for (obj *expr = reader.read(); expr; expr = reader.read()) {
+        if (done > 0) { --done; continue; }
+
+        std::map<std::string, const function*> used;
+        obj *form = expand(expr, root, &used);
+        entries.push_back(new pair(form, macro_list(used, root)));
+        result = eval(form, root);
+    }
+
+    write_cache(cache_path, header, source, vec2list(entries), root);
+    return result;
+}// load_module
+
+
+}// namespace sic
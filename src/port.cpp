@@ -0,0 +1,272 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Input and output ports.
+
+#include <string>
+#include <istream>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <set>
+
+#include <unistd.h>
+
+#include "sic.hpp"
+
+namespace sic {
+
+
+//
+// Input ports
+//
+
+input_port::input_port(const std::string& path) {
+    std::ifstream *f = new std::ifstream(path);
+    owned.reset(f);
+    in = f;
+
+    if (!f->is_open()) {
+        throw io_error("Unable to open '" + path + "': " + strerror(errno));
+    }
+}// input_port::input_port
+
+
+bool
+input_port::read_line() {
+    if (!in) { throw io_error("Reading from a closed port."); }
+    return (bool)std::getline(*in, buffer);
+}// read_line
+
+
+obj *
+input_port::read_form() {
+    if (!in) { throw io_error("Reading from a closed port."); }
+    return read(*in);
+}// read_form
+
+
+std::istream&
+input_port::stream() {
+    if (!in) { throw io_error("Reading from a closed port."); }
+    return *in;
+}// stream
+
+
+void
+input_port::close() {
+    owned.reset();
+    in = nullptr;
+}// close
+
+
+input_port *
+stdin_port() {
+    static input_port * const port = new input_port(std::cin);
+    return port;
+}// stdin_port
+
+
+
+
+//
+// Output ports
+//
+
+output_port::port_buf::port_buf(std::ostream *out, std::size_t size) :
+    sink(out)
+{
+    resize(size);
+}// port_buf::port_buf
+
+
+void
+output_port::port_buf::drain() {
+    if (sink && pptr() > pbase()) {
+        sink->write(pbase(), pptr() - pbase());
+    }
+    setp(space.data(), space.data() + space.size());
+}// drain
+
+
+void
+output_port::port_buf::resize(std::size_t size) {
+    drain();
+    space.resize(size);
+    space.shrink_to_fit();
+    setp(space.data(), space.data() + space.size());
+}// resize
+
+
+int
+output_port::port_buf::overflow(int c) {
+    if (!sink) { return traits_type::eof(); }
+
+    drain();
+    if (c == traits_type::eof()) { return traits_type::not_eof(c); }
+
+    if (space.empty()) {
+        sink->put((char)c);
+    } else {
+        *pptr() = (char)c;
+        pbump(1);
+    }
+
+    return c;
+}// overflow
+
+
+std::streamsize
+output_port::port_buf::xsputn(const char *s, std::streamsize n) {
+    if (!sink) { return 0; }
+
+    if (n > epptr() - pptr()) {
+        drain();
+
+        // Too big to buffer so just send it along.
+        if (n > epptr() - pptr()) {
+            sink->write(s, n);
+            return n;
+        }
+    }
+
+    memcpy(pptr(), s, n);
+    pbump((int)n);
+    return n;
+}// xsputn
+
+
+int
+output_port::port_buf::sync() {
+    if (!sink) { return -1; }
+
+    drain();
+    sink->flush();
+    return 0;
+}// sync
+
+
+// The set of open ports, so we can flush them all at exit.
+static std::set<output_port*>&
+open_ports(std::mutex **lock) {
+    static std::set<output_port*> ports;
+    static std::mutex ports_lock;
+    static bool registered = (std::atexit(output_port::flush_all), true);
+
+    (void)registered;
+    *lock = &ports_lock;
+    return ports;
+}// open_ports
+
+static void
+track(output_port *port, bool add) {
+    std::mutex *lock;
+    std::set<output_port*>& ports = open_ports(&lock);
+
+    std::lock_guard<std::mutex> guard(*lock);
+    if (add) {
+        ports.insert(port);
+    } else {
+        ports.erase(port);
+    }
+}// track
+
+
+static std::ostream *
+open_output_file(const std::string& path) {
+    std::ofstream *f = new std::ofstream();
+    f->rdbuf()->pubsetbuf(nullptr, 0);     // We do our own buffering
+    f->open(path);
+
+    if (!f->is_open()) {
+        delete f;
+        throw io_error("Unable to open '" + path + "': " + strerror(errno));
+    }
+
+    return f;
+}// open_output_file
+
+
+output_port::output_port(std::ostream& s, std::size_t size) :
+    buf(&s, size), out(&buf)
+{
+    track(this, true);
+}// output_port::output_port
+
+output_port::output_port(const std::string& path, std::size_t size) :
+    owned(open_output_file(path)), buf(owned.get(), size), out(&buf)
+{
+    track(this, true);
+}// output_port::output_port
+
+
+void
+output_port::write(std::string_view text) {
+    std::lock_guard<std::mutex> guard(lock);
+    out.write(text.data(), text.size());
+    if (!out) { throw io_error("Writing to a closed port."); }
+}// write
+
+
+void
+output_port::flush() {
+    std::lock_guard<std::mutex> guard(lock);
+    out.flush();
+}// flush
+
+
+void
+output_port::set_buffer_size(std::size_t size) {
+    std::lock_guard<std::mutex> guard(lock);
+    buf.resize(size);
+}// set_buffer_size
+
+
+void
+output_port::close() {
+    track(this, false);
+
+    std::lock_guard<std::mutex> guard(lock);
+    out.flush();
+    buf.detach();
+    owned.reset();
+}// close
+
+
+void
+output_port::flush_all() {
+    std::mutex *lock;
+    std::set<output_port*>& ports = open_ports(&lock);
+
+    std::lock_guard<std::mutex> guard(*lock);
+    for (output_port *port : ports) {
+        port->flush();
+    }
+}// flush_all
+
+
+// Standard output is only buffered here if it's not a terminal;
+// otherwise, interactive output would show up late.
+output_port *
+stdout_port() {
+    static output_port * const port =
+        new output_port(std::cout,
+                        isatty(1) ? 0 : output_port::default_buffer_size);
+    return port;
+}// stdout_port
+
+
+// Standard error is never buffered.  Writing to it flushes stdout
+// first so the two stay in order.
+output_port *
+stderr_port() {
+    static output_port * const port = []() {
+        output_port *p = new output_port(std::cerr, 0);
+        p->stream().tie(&stdout_port()->stream());
+        return p;
+    }();
+    return port;
+}// stderr_port
+
+
+}// namespace sic
@@ -0,0 +1,90 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Prepared expressions.  See class prepared in sic.hpp.
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "sic.hpp"
+
+namespace sic {
+
+// Look up 'name' without throwing; returns nullptr if it's undefined.
+static obj *
+lookup(const context *ctx, const std::string& name) {
+    for (const context *c = ctx; c; c = c->parent) {
+        if (c->has(name)) { return c->get(name); }
+    }
+    return nullptr;
+}// lookup
+
+
+// Replace symbols in function position that name builtins (and
+// aren't parameters) with the builtins.  Quoted forms are left
+// alone; this includes the bodies of expanded `let`s and functions,
+// which are evaluated in contexts we can't see from here.
+static obj *
+resolve(obj *expr, const context *ctx, const std::vector<std::string>& params) {
+    if (expr == nil || !expr->isList()) { return expr; }
+
+    pair *pexpr = dca<pair>(expr);
+    if (pexpr->first == quote) { return expr; }
+
+    obj *head = pexpr->first;
+    if (head->isSymbol()) {
+        const std::string& name = dca<symbol>(head)->text;
+        obj *value = lookup(ctx, name);
+        if (dynamic_cast<builtin*>(value) &&
+            std::find(params.begin(), params.end(), name) == params.end())
+        {
+            head = value;
+        }
+    } else {
+        head = resolve(head, ctx, params);
+    }
+
+    return new pair(
+        head,
+        basic_map(dca<pair>(pexpr->rest),
+                  [&](obj *arg) { return resolve(arg, ctx, params); }));
+}// resolve
+
+
+prepared::prepared(context *ctx, std::vector<std::string> ps, obj *expr) :
+    scope(ctx),
+    params(std::move(ps)),
+    body(resolve(expand(expr, ctx), ctx, params))
+{}
+
+// Return the (first) expression in 'source'.
+static obj *
+parse(std::string_view source) {
+    obj *expr = sic::read(source);
+    if (!expr) { throw syntax_error("Empty expression"); }
+    return expr;
+}// parse
+
+prepared::prepared(context *ctx, std::vector<std::string> ps,
+                   std::string_view source) :
+    prepared(ctx, std::move(ps), parse(source))
+{}
+
+
+obj *
+prepared::call(const std::vector<obj*>& args) const {
+    if (args.size() != params.size()) {
+        throw arg_count(params.size(), args.size());
+    }
+
+    context *ctx = new context(scope);
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        ctx->define(params[i], args[i]);
+    }
+
+    return eval(body, ctx);
+}// call
+
+
+}// namespace sic
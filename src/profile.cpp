@@ -0,0 +1,161 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// The call profiler.  See class profiler in sic.hpp.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+
+#include "sic.hpp"
+
+namespace sic {
+
+thread_local profiler *profiler::current = nullptr;
+
+profiler::profiler() : previous(current) {
+    nodes.push_back({0, nullptr, nullptr});
+    current = this;
+}
+
+profiler::~profiler() {
+    current = previous;
+}
+
+
+void
+profiler::enter(const callable *fn) {
+    std::size_t parent = stack.empty() ? 0 : stack.back().node;
+
+    std::size_t id;
+    auto found = nodes[parent].children.find(fn);
+    if (found != nodes[parent].children.end()) {
+        id = found->second;
+    } else {
+        id = nodes.size();
+        nodes[parent].children[fn] = id;
+        nodes.push_back({parent, fn, &by_fn[fn]});
+    }
+
+    stats *st = nodes[id].st;
+    ++st->calls;
+    ++st->active;
+
+    stack.push_back({id, clock::now()});
+}// enter
+
+
+void
+profiler::leave() {
+    const frame f = stack.back();
+    stack.pop_back();
+
+    clock::duration elapsed = clock::now() - f.start;
+    clock::duration self = elapsed - f.children;
+
+    node& n = nodes[f.node];
+    n.self += self;
+    n.st->self += self;
+
+    // Recursive calls are already included in the outermost one.
+    if (--n.st->active == 0) { n.st->inclusive += elapsed; }
+
+    if (!stack.empty()) { stack.back().children += elapsed; }
+}// leave
+
+
+
+// Return the name of 'fn': its primary name if it's a builtin or
+// else the name it's bound to in 'ctx' (or one of its parents).
+std::string
+callable_name(const callable *fn, const context *ctx) {
+    static const std::map<const callable*, std::string> builtins = []() {
+        std::map<const callable*, std::string> result;
+        for (const auto& item : builtin_table()) {
+            result[item.second] = item.first;
+        }
+        return result;
+    }();
+
+    auto found = builtins.find(fn);
+    if (found != builtins.end()) { return found->second; }
+
+    std::string name = ctx->name_of(fn);
+    return name.empty() ? "<anonymous>" : name;
+}// callable_name
+
+
+static double
+msec(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+
+void
+profiler::report(std::ostream& out, const context *ctx) const {
+    std::vector<std::pair<const callable*, const stats*>> rows;
+    clock::duration total{0};
+    for (const auto& item : by_fn) {
+        rows.push_back({item.first, &item.second});
+        total += item.second.self;
+    }
+
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return a.second->self > b.second->self;
+        });
+
+    char line[160];
+    snprintf(line, sizeof(line), "%10s %12s %12s %7s  %s\n",
+             "calls", "incl ms", "self ms", "self %", "name");
+    out << line;
+
+    for (const auto& row : rows) {
+        const stats& st = *row.second;
+        snprintf(line, sizeof(line), "%10llu %12.3f %12.3f %7.2f  ",
+                 (unsigned long long)st.calls, msec(st.inclusive),
+                 msec(st.self),
+                 total.count() ? 100.0 * st.self.count() / total.count() : 0.0);
+        out << line << callable_name(row.first, ctx) << "\n";
+    }
+}// report
+
+
+void
+profiler::folded(std::ostream& out, const context *ctx) const {
+    std::map<const callable*, std::string> names;
+    auto name = [&](const callable *fn) -> const std::string& {
+        auto found = names.find(fn);
+        if (found != names.end()) { return found->second; }
+
+        // Separators can't appear in names.
+        std::string nm = callable_name(fn, ctx);
+        std::replace(nm.begin(), nm.end(), ';', '_');
+        std::replace(nm.begin(), nm.end(), ' ', '_');
+        return names[fn] = nm;
+    };
+
+    for (std::size_t i = 1; i < nodes.size(); ++i) {
+        auto usec =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                nodes[i].self).count();
+        if (usec == 0) { continue; }
+
+        std::vector<std::size_t> path;
+        for (std::size_t n = i; n != 0; n = nodes[n].parent) {
+            path.push_back(n);
+        }
+
+        std::string stack;
+        for (auto n = path.rbegin(); n != path.rend(); ++n) {
+            if (!stack.empty()) { stack += ";"; }
+            stack += name(nodes[*n].fn);
+        }
+
+        out << stack << " " << usec << "\n";
+    }// for
+}// folded
+
+
+}// namespace sic
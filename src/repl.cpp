@@ -3,16 +3,26 @@
 
 #include "sic.hpp"
 #include "unit.hpp"
+#include "server.hpp"
 
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <fstream>
 #include <memory>
+#include <cstring>
+#include <csignal>
+
+#include <unistd.h>
 
 
 using namespace sic;
 
+// All output goes through the ports so that it's buffered and stays
+// in order with what scripts print.
+static std::ostream& out() { return stdout_port()->stream(); }
+static std::ostream& err() { return stderr_port()->stream(); }
+
 static bool
 is_test(const std::string& name) {
     const std::string ending = ".sictest";
@@ -35,7 +45,7 @@ read_and_eval(bool *keepGoing, context *ctx) {
 
         return eval(expr, ctx);
     } catch(const error& e) {
-        std::cout << "ERROR: " << e.msg() << "\n";
+        out() << "ERROR: " << e.msg() << "\n";
     }
 
     return nullptr;
@@ -43,32 +53,29 @@ read_and_eval(bool *keepGoing, context *ctx) {
 
 
 static void
-repl() {
-    const std::unique_ptr<context> root(root_context());
+repl(context *root) {
     bool go = true;
 
     while(go) {
         if (!std::cin.good()) { return; }
 
-        std::cout << "> ";
-        std::cout.flush();
+        out() << "> ";
+        out().flush();
 
-        obj *result = read_and_eval(&go, root.get());
+        obj *result = read_and_eval(&go, root);
         if (result && result != nil) {
-            std::cout << printstr(result) << "\n";
+            out() << printstr(result) << "\n";
         }// if
     }// while
 }// repl
 
 static int
-run_script(const std::string& path, obj *argv) {
-    context* root = root_context();
-
-    std::fstream in;
+run_script(context *root, const std::string& path, obj *argv) {
+    std::ifstream in;
     in.open(path);
 
     if (!in.is_open()) {
-        std::cerr << "Unable to open '" << path << "'\n";
+        err() << "Unable to open '" << path << "'\n";
         exit(2);
     }// if
 
@@ -82,36 +89,52 @@ run_script(const std::string& path, obj *argv) {
         // Set the argument list.
         root->set("argv", argv);
 
-        while (in.good()) {
-            obj *expr = read(in);
-            if (!expr) { break; }
+        // Regular files are mapped and read straight from memory;
+        // anything else (pipes, devices, etc.) goes through the
+        // stream.
+        std::unique_ptr<mapped_file> mapped;
+        try {
+            mapped = std::make_unique<mapped_file>(path);
+        } catch (const error&) {}
+
+        if (mapped) {
+            buffer_reader reader(mapped->text());
+            for (obj *expr = reader.read(); expr; expr = reader.read()) {
+                eval(expr, root);
+            }
+        } else {
+            while (in.good()) {
+                obj *expr = read(in);
+                if (!expr) { break; }
 
-            eval(expr, root);
-        }// while
+                eval(expr, root);
+            }// while
+        }// if .. else
 
         if (testmode) {
             if (tests_run(root) == 0) {
-                std::cerr << "ERROR: test script '" << path
+                err() << "ERROR: test script '" << path
                           << "' contains no tests.\n";
                 return 1;
             }
 
-            std::cout << "Ran " << tests_run(root) << " test(s)\n";
+            out() << "Ran " << tests_run(root) << " test(s)\n";
 
             if (!success(root)) {
                 long f = failures(root);
-                std::cout << f << " tests failed!\n";
+                out() << f << " tests failed!\n";
                 return f;
             }// if
 
             if (failures(root) > 0) {
-                std::cout << "(All failures were expected.)\n";
+                out() << "(All failures were expected.)\n";
             }// if
         }// if
 
         return 0;
     } catch (const error& e) {
-        std::cerr << "ERROR: " << e.longmsg() << "\n";
+        err() << "ERROR: " << e.longmsg() << "\n";
+        if (tracer::enabled()) { tracer::dump(err(), root); }
         return 1;
     }// catch
 
@@ -134,14 +157,115 @@ argv_list(int argc, char *argv[]) {
 
 int
 main(int argc, char *argv[]) {
+    // Nothing here uses C stdio so the C++ streams can do their own
+    // buffering.  We leave terminals alone so interactive output
+    // still shows up promptly.
+    if (!isatty(1)) {
+        std::ios::sync_with_stdio(false);
+        std::cin.tie(nullptr);
+    }
+
+    // SIGUSR1 dumps the evaluation trace.
+    signal(SIGUSR1, [](int) { tracer::request_dump(); });
+
+    // Leading options
+    std::string image, serve_path, connect_path, profile_path;
+    bool show_heap_stats = false;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg) {
+        std::string opt = argv[arg];
+
+        if (opt == "--") {
+            ++arg;
+            break;
+        } else if (opt == "--image" && arg + 1 < argc) {
+            image = argv[++arg];
+        } else if (opt == "--profile" && arg + 1 < argc) {
+            profile_path = argv[++arg];
+        } else if (opt == "--trace") {
+            tracer::enable(true);
+        } else if (opt == "--heap-stats") {
+            show_heap_stats = true;
+        } else if (opt == "--serve" && arg + 1 < argc) {
+            serve_path = argv[++arg];
+        } else if (opt == "--connect" && arg + 1 < argc) {
+            connect_path = argv[++arg];
+        } else {
+            err() << "Usage: " << argv[0]
+                  << " [--image file] [--profile file] [--heap-stats] [--trace]"
+                  << " [script [args ...]]\n"
+                  << "       " << argv[0]
+                  << " [--image file] --serve socket [script ...]\n"
+                  << "       " << argv[0] << " --connect socket [script]\n";
+            return 2;
+        }
+    }// for
+
+    if (!connect_path.empty()) {
+        std::ifstream file;
+        if (arg < argc) {
+            file.open(argv[arg]);
+            if (!file.is_open()) {
+                err() << "Unable to open '" << argv[arg] << "'\n";
+                return 2;
+            }
+        }
+
+        std::istream& in = arg < argc ? file : std::cin;
+        std::string script((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+        try {
+            return send_request(connect_path, script);
+        } catch (const error& e) {
+            err() << "ERROR: " << e.msg() << "\n";
+            return 2;
+        }
+    }// if
+
     try {
-        if (argc >= 2) {
-            return run_script(argv[1], argv_list(argc, argv));
+        context *root = root_context();
+        if (!image.empty()) { load_image(root, image); }
+
+        // Scripts named after --serve are preloaded into the server.
+        if (!serve_path.empty()) {
+            for (; arg < argc; ++arg) { load_module(root, argv[arg]); }
+            return serve(root, serve_path);
+        }
+
+        // With --profile, the whole run is profiled; the table goes
+        // to stderr and the folded stacks to the named file.
+        std::unique_ptr<profiler> prof;
+        if (!profile_path.empty()) { prof = std::make_unique<profiler>(); }
+
+        int status = 0;
+        if (arg < argc) {
+            // The script's argv leaves out our options.
+            std::vector<char*> script_argv(argv + arg, argv + argc);
+            script_argv.insert(script_argv.begin(), argv[0]);
+
+            status = run_script(root, argv[arg],
+                                argv_list(script_argv.size(),
+                                          script_argv.data()));
         } else {
-            repl();
+            repl(root);
         }// if .. else
+
+        if (prof) {
+            prof->report(err(), root);
+
+            std::ofstream folded(profile_path);
+            prof->folded(folded, root);
+            if (!folded) {
+                err() << "Unable to write '" << profile_path << "'\n";
+                return 2;
+            }
+        }// if
+
+        if (show_heap_stats) { heap_stats::report(err(), root); }
+
+        return status;
     } catch (sic::error& e) {
-        std::cout << "Uncaught sic exception: " << e.msg() << "\n";
+        out() << "Uncaught sic exception: " << e.msg() << "\n";
         return 2;
     }// catch
 
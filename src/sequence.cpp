@@ -0,0 +1,206 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Lazy sequences.  Each stage wraps the sink it's given and passes
+// the result to the stage before it, so running a pipeline is a single
+// loop in the source with the stages' work done per value.
+
+#include <cmath>
+
+#include "sic.hpp"
+
+namespace sic {
+
+class range_seq : public sequence {
+    const double start, end, step;
+public:
+    range_seq(double s, double e, double st) : start(s), end(e), step(st) {}
+
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        // Multiply rather than add so that fractional steps don't
+        // accumulate rounding error.
+        for (double i = 0; ; ++i) {
+            double value = start + i * step;
+            if (step > 0 ? value >= end : value <= end) { return true; }
+            budget::step();
+            if (!sink(new number(value))) { return false; }
+        }
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::RANGE};
+        p.start = start; p.end = end; p.step = step;
+        return p;
+    }
+};
+
+class list_seq : public sequence {
+    obj * const items;
+public:
+    explicit list_seq(obj *i) : items(i) {}
+
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        if (foreign_buffer *buf = dynamic_cast<foreign_buffer*>(items)) {
+            for (std::size_t i = 0; i < buf->size(); ++i) {
+                budget::step();
+                if (!sink(new number(buf->value(i)))) { return false; }
+            }
+            return true;
+        }
+
+        for (obj *c = items; c != nil; c = dca<pair>(c)->rest) {
+            budget::step();
+            if (!sink(dca<pair>(c)->first)) { return false; }
+        }
+        return true;
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::ITEMS};
+        p.source = items;
+        return p;
+    }
+};
+
+class map_seq : public sequence {
+    const sequence * const source;
+    callable * const fn;
+    context * const ctx;
+public:
+    map_seq(const sequence *s, callable *f, context *c)
+        : source(s), fn(f), ctx(c) {}
+
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        return source->each([&](obj *item) {
+                return sink(fn->apply(&item, 1, ctx));
+            });
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::MAP};
+        p.source = const_cast<sequence*>(source); p.fn = fn; p.ctx = ctx;
+        return p;
+    }
+};
+
+class filter_seq : public sequence {
+    const sequence * const source;
+    callable * const fn;
+    context * const ctx;
+public:
+    filter_seq(const sequence *s, callable *f, context *c)
+        : source(s), fn(f), ctx(c) {}
+
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        return source->each([&](obj *item) {
+                return fn->apply(&item, 1, ctx)->isTrue() ? sink(item) : true;
+            });
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::FILTER};
+        p.source = const_cast<sequence*>(source); p.fn = fn; p.ctx = ctx;
+        return p;
+    }
+};
+
+class take_seq : public sequence {
+    const sequence * const source;
+    const std::size_t count;
+public:
+    take_seq(const sequence *s, std::size_t n) : source(s), count(n) {}
+
+    // We stop the source as soon as we have 'count' values so that
+    // taking from an infinite range terminates.
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        if (count == 0) { return true; }
+
+        std::size_t left = count;
+        bool stopped = false;
+        source->each([&](obj *item) {
+                if (!sink(item)) { stopped = true; return false; }
+                return --left > 0;
+            });
+        return !stopped;
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::TAKE};
+        p.source = const_cast<sequence*>(source); p.count = count;
+        return p;
+    }
+};
+
+class drop_seq : public sequence {
+    const sequence * const source;
+    const std::size_t count;
+public:
+    drop_seq(const sequence *s, std::size_t n) : source(s), count(n) {}
+
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        std::size_t skip = count;
+        return source->each([&](obj *item) {
+                if (skip > 0) { --skip; return true; }
+                return sink(item);
+            });
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::DROP};
+        p.source = const_cast<sequence*>(source); p.count = count;
+        return p;
+    }
+};
+
+
+sequence *
+sequence::range(double start, double end, double step) {
+    if (step == 0 || std::isnan(step)) {
+        throw bad_arg("a non-zero step", std::to_string(step));
+    }
+    return new range_seq(start, end, step);
+}// range
+
+sequence *
+sequence::of(obj *items) {
+    if (!dynamic_cast<foreign_buffer*>(items) && !items->isList()) {
+        throw wrong_type("list or buffer", printstr(items));
+    }
+    return new list_seq(items);
+}// of
+
+sequence *
+sequence::rebuild(const parts& p) {
+    switch (p.kind) {
+    case parts::RANGE:  return range(p.start, p.end, p.step);
+    case parts::ITEMS:  return of(p.source);
+    case parts::MAP:    return dca<sequence>(p.source)->map(p.fn, p.ctx);
+    case parts::FILTER: return dca<sequence>(p.source)->filter(p.fn, p.ctx);
+    case parts::TAKE:   return dca<sequence>(p.source)->take(p.count);
+    case parts::DROP:   return dca<sequence>(p.source)->drop(p.count);
+    case parts::FORMS:  return forms(p.source);
+    }
+    throw bad_arg("a kind of sequence", std::to_string((int)p.kind));
+}// rebuild
+
+sequence *
+sequence::map(callable *fn, context *ctx) const {
+    return new map_seq(this, fn, ctx);
+}// map
+
+sequence *
+sequence::filter(callable *fn, context *ctx) const {
+    return new filter_seq(this, fn, ctx);
+}// filter
+
+sequence *
+sequence::take(std::size_t n) const {
+    return new take_seq(this, n);
+}// take
+
+sequence *
+sequence::drop(std::size_t n) const {
+    return new drop_seq(this, n);
+}// drop
+
+}// namespace sic
@@ -0,0 +1,246 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// Server mode: keep a warm interpreter around and run scripts sent
+// to it over a Unix domain socket.
+//
+// A request is the text of a script; the client sends it and then
+// shuts down its end of the connection for writing.  The server
+// forks a child for each connection which evaluates the script with
+// its standard output and error going to the socket and then exits.
+// Each request therefore sees its own copy-on-write copy of the
+// server's root context (so it can define globals freely) and any
+// number of clients can be served at once.
+//
+// The server keeps its end of each connection open until the child
+// has exited and then sends the child's exit status as one final
+// byte before closing it, so the client can tell whether the script
+// succeeded.
+
+#include <string>
+#include <map>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "server.hpp"
+
+namespace sic {
+
+static sockaddr_un
+socket_address(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw io_error("Socket path too long: '" + path + "'");
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    return addr;
+}// socket_address
+
+
+// Read from 'fd' until end of file.
+static std::string
+read_all(int fd) {
+    std::string result;
+    char buf[64 * 1024];
+
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { break; }
+        result.append(buf, n);
+    }
+
+    return result;
+}// read_all
+
+
+static bool
+write_all(int fd, const char *data, std::size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { return false; }
+        data += n;
+        len -= n;
+    }
+    return true;
+}// write_all
+
+
+// Run one request in the (forked) child.
+static int
+handle_request(int conn, context *root) {
+    const std::string script = read_all(conn);
+
+    dup2(conn, 1);
+    dup2(conn, 2);
+    ::close(conn);
+
+    // stdout may have been unbuffered if the server was started from
+    // a terminal.
+    stdout_port()->set_buffer_size(output_port::default_buffer_size);
+
+    try {
+        buffer_reader reader(script);
+        for (obj *expr = reader.read(); expr; expr = reader.read()) {
+            eval(expr, root);
+        }
+    } catch (const error& e) {
+        stderr_port()->stream() << "ERROR: " << e.longmsg() << "\n";
+        return 1;
+    }
+
+    return 0;
+}// handle_request
+
+
+// Send the exit status of each child that has finished to its client
+// and close the connection.
+static void
+reap_children(std::map<pid_t, int>& requests) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        auto found = requests.find(pid);
+        if (found == requests.end()) { continue; }
+
+        unsigned char code = WIFEXITED(status) ? WEXITSTATUS(status)
+                                               : 128 + WTERMSIG(status);
+        // The client may have gone away; that mustn't kill us.
+        ::send(found->second, &code, 1, MSG_NOSIGNAL);
+        ::close(found->second);
+        requests.erase(found);
+    }
+}// reap_children
+
+
+// Listen on the Unix socket at 'path' and evaluate each script sent
+// to it in a copy of 'root'.  Only returns (with an exit status) if
+// the socket can't be set up.
+int
+serve(context *root, const std::string& path) {
+    const sockaddr_un addr = socket_address(path);
+
+    // Replace a socket left behind by an earlier server but nothing
+    // else.
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 ||
+        bind(listener, (const sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listener, SOMAXCONN) < 0)
+    {
+        throw io_error("Unable to listen on '" + path + "': " +
+                       strerror(errno));
+    }
+
+    // SIGCHLD is blocked except while we wait for a connection so
+    // that a child exiting interrupts the wait but can't slip in
+    // between reaping and waiting.  (It needs a handler for that; the
+    // default action is to ignore it.)
+    struct sigaction on_child = {};
+    on_child.sa_handler = [](int) {};
+    sigaction(SIGCHLD, &on_child, nullptr);
+
+    sigset_t chld, waiting;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &waiting);
+    sigdelset(&waiting, SIGCHLD);
+
+    std::map<pid_t, int> requests;     // Running children's connections
+    while (true) {
+        reap_children(requests);
+
+        pollfd ready = {listener, POLLIN, 0};
+        if (ppoll(&ready, 1, nullptr, &waiting) < 0) {
+            if (errno == EINTR) { continue; }
+            throw io_error(std::string("poll() failed: ") + strerror(errno));
+        }
+
+        int conn = accept(listener, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) { continue; }
+            throw io_error(std::string("accept() failed: ") + strerror(errno));
+        }
+
+        // Anything still buffered would otherwise be written by both
+        // processes.
+        output_port::flush_all();
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            ::close(listener);
+            for (const auto& request : requests) { ::close(request.second); }
+            sigprocmask(SIG_SETMASK, &waiting, nullptr);
+            signal(SIGCHLD, SIG_DFL);
+            exit(handle_request(conn, root));
+        }
+
+        if (pid < 0) {
+            stderr_port()->stream() << "fork() failed: " << strerror(errno)
+                                    << "\n";
+            ::close(conn);
+            continue;
+        }
+        requests[pid] = conn;
+    }// while
+
+    return 0;   // Not reached
+}// serve
+
+
+// Send 'script' to the server at 'path' and copy its output to our
+// standard output.  Returns the script's exit status (1 if the
+// connection closed without one).
+int
+send_request(const std::string& path, const std::string& script) {
+    const sockaddr_un addr = socket_address(path);
+
+    int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conn < 0 || connect(conn, (const sockaddr *)&addr, sizeof(addr)) < 0) {
+        throw io_error("Unable to connect to '" + path + "': " +
+                       strerror(errno));
+    }
+
+    if (!write_all(conn, script.data(), script.size())) {
+        throw io_error("Unable to send request: " +
+                       std::string(strerror(errno)));
+    }
+    shutdown(conn, SHUT_WR);
+
+    // The last byte is the status, so we hold back the last byte of
+    // each read until we know more follows.
+    char buf[64 * 1024];
+    std::size_t held = 0;
+    while (true) {
+        ssize_t n = ::read(conn, buf + held, sizeof(buf) - held);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { break; }
+
+        std::size_t len = held + n;
+        write_all(1, buf, len - 1);
+        buf[0] = buf[len - 1];
+        held = 1;
+    }
+
+    ::close(conn);
+    return held ? (unsigned char)buf[0] : 1;
+}// send_request
+
+
+}// namespace sic
@@ -0,0 +1,13 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+# pragma once
+
+#include <sic.hpp>
+
+namespace sic {
+
+int serve(context *root, const std::string& path);
+int send_request(const std::string& path, const std::string& script);
+
+};
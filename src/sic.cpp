@@ -5,9 +5,25 @@
 #include <exception>
 #include <map>
 #include <vector>
+#include <deque>
 #include <istream>
 #include <iostream>
+#include <fstream>
 #include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <array>
+#include <charconv>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <climits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "sic.hpp"
 
@@ -43,6 +59,133 @@ static obj *unnamed_fun_helper(std::vector<obj*> args,
              isMacro  ? (obj*)t : (obj*)nil);
 }
 
+// Back-end helper for builtins that read from either a port or a
+// named file.  If 'source' is a string, it's opened as a file for
+// the duration of the call to 'reader'.
+static void with_input(obj *source,
+                       const std::function<void(input_port*)>& reader) {
+    if (!source->isString()) {
+        reader(dca<input_port>(source));
+        return;
+    }
+
+    std::unique_ptr<input_port> port(
+        new input_port(dca<string>(source)->str()));
+    reader(port.get());
+}
+
+// Back-end for print and write: if the first argument is an output
+// port, write the rest to it; otherwise, write everything to stdout.
+static obj *print_helper(const std::vector<obj*>& args, context *ctx,
+                         bool forDebugging) {
+    auto start = args.begin();
+    output_port *port = stdout_port();
+    if (start != args.end()) {
+        if (output_port *p = dynamic_cast<output_port*>(*start)) {
+            port = p;
+            ++start;
+        }
+    }
+
+    for (auto i = start; i != args.end(); ++i) {
+        port->write(printstr(*i, ctx, forDebugging));
+    }
+
+    return nil;
+}
+
+// Back-end helpers for the writing builtins: the output port given as
+// the first argument (which is then skipped) or stdout.
+static output_port *leading_port(std::vector<obj*>& args) {
+    if (!args.empty()) {
+        if (output_port *p = dynamic_cast<output_port*>(args[0])) {
+            args.erase(args.begin());
+            return p;
+        }
+    }
+    return stdout_port();
+}
+
+// The CSV separator in args[i] (a one-character string) or a comma.
+static char csv_separator(const std::vector<obj*>& args, std::size_t i) {
+    if (i >= args.size()) { return ','; }
+
+    std::string_view sep = dca<string>(args[i])->contents;
+    if (sep.size() != 1) {
+        throw bad_arg("a one-character separator", printstr(args[i]));
+    }
+    return sep[0];
+}
+
+// The index or count in args[i], truncated toward zero.  NaN and the
+// infinities are rejected; other values too big for a long are
+// clamped to its range, since callers clip indexes anyway.
+static long index_arg(const std::vector<obj*>& args, std::size_t i) {
+    double val = dca<number>(args[i])->val;
+    if (!std::isfinite(val)) {
+        throw bad_arg("a finite number", printstr(args[i]));
+    }
+
+    // (double)LONG_MAX rounds up to 2^63, which is out of range.
+    if (val >= (double)LONG_MAX) { return LONG_MAX; }
+    if (val <= (double)LONG_MIN) { return LONG_MIN; }
+    return (long)val;
+}
+
+// Back-end for read-forms: the expressions in a port or file, read
+// one at a time as the sequence runs.  A path is reopened each time
+// the sequence runs (and mapped into memory if it names a regular
+// file); a port is read from where it is, so running the sequence
+// again carries on from where the last run stopped.
+class forms_seq : public sequence {
+    obj * const source;
+public:
+    explicit forms_seq(obj *s) : source(s) {
+        if (!source->isString()) { dca<input_port>(source); }
+    }
+
+    virtual bool each(const std::function<bool(obj*)>& sink) const override {
+        std::unique_ptr<mapped_file> mapped;
+        if (source->isString()) {
+            try {
+                mapped = std::make_unique<mapped_file>(
+                    dca<string>(source)->str());
+            } catch (const error&) {}
+        }
+
+        if (mapped) {
+            buffer_reader reader(mapped->text());
+            for (obj *form = reader.read(); form; form = reader.read()) {
+                budget::step();
+                if (!sink(form)) { return false; }
+            }
+            return true;
+        }
+
+        bool finished = true;
+        with_input(source, [&](input_port *port) {
+                for (obj *form = port->read_form(); form;
+                     form = port->read_form())
+                {
+                    budget::step();
+                    if (!sink(form)) { finished = false; return; }
+                }
+            });
+        return finished;
+    }
+
+    virtual parts describe() const override {
+        parts p{parts::FORMS};
+        p.source = source;
+        return p;
+    }
+};
+
+sequence *
+sequence::forms(obj *input) {
+    return new forms_seq(input);
+}
+
 //
 // Define the builtins.
 //
@@ -54,7 +197,7 @@ static obj *unnamed_fun_helper(std::vector<obj*> args,
 #define BUILTIN_FULL(name, min_args, is_varargs, is_macro)    \
     callable * const name = \
         new builtin(min_args, is_varargs, is_macro,     \
-                    [](std::vector<obj*> args, context* ctx) -> obj*
+                    [](std::vector<obj*>& args, context* ctx) -> obj*
 #define ENDF );
 
 #include "sic_func.inc"
@@ -63,31 +206,90 @@ static obj *unnamed_fun_helper(std::vector<obj*> args,
 
 std::size_t
 llen(obj *lst_obj) {
-    std::size_t len = 0;
+    if (lst_obj->isAtom() || lst_obj == nil) { return 0; }
 
-    pair *lst = dynamic_cast<pair*>(lst_obj);
-    if (!lst) { return 0; }
+    pair *lst = static_cast<pair*>(lst_obj);
+    if (lst->length > 0) { return lst->length; }
 
-    for (pair *cel = lst; cel != nil; cel = dca<pair>(cel->rest)) {
-        ++len;
-        if (cel->rest->isAtom()) { throw wrong_type("list", printstr(cel->rest));}
-    }
-
-    return len;
+    // Not a proper list; find the offending tail for the message.
+    obj *tail = lst;
+    while (!tail->isAtom()) { tail = static_cast<pair*>(tail)->rest; }
+    throw wrong_type("list", printstr(tail));
 }// llen
 
 
-static obj *
-reverse_helper(obj *list, obj *reversed) {
-    if (list == nil) { return reversed; }
+// Mix 'h' into 'seed' (as boost::hash_combine does).
+static inline std::size_t
+hash_combine(std::size_t seed, std::size_t h) {
+    return seed ^ (h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}// hash_combine
+
+
+bool
+pair::equals(obj *o) const {
+    const pair *a = this;
+    obj *b = o;
+
+    while (true) {
+        if (a == b) { return true; }
+
+        // Pairs are the only non-atoms so we can skip the dynamic_cast.
+        if (a == nil || b == nil || b->isAtom()) { return false; }
+        const pair *bp = static_cast<const pair*>(b);
+
+        // If both hashes are known, they can rule out a match.
+        std::size_t ha = a->cached_hash.load(std::memory_order_relaxed);
+        std::size_t hb = bp->cached_hash.load(std::memory_order_relaxed);
+        if (ha && hb && ha != hb) { return false; }
+
+        if (!a->first->equals(bp->first)) { return false; }
+
+        if (a->rest->isAtom()) { return a->rest->equals(bp->rest); }
+        a = static_cast<const pair*>(a->rest);
+        b = bp->rest;
+    }// while
+}// equals
+
+
+std::size_t
+pair::hash() const {
+    std::size_t h = cached_hash.load(std::memory_order_relaxed);
+    if (h) { return h; }
+
+    // Collect the cells up to the end of the list or the first one
+    // whose hash is already known, then hash them back to front so
+    // that every suffix gets cached too.
+    std::vector<const pair*> cells;
+    const pair *cell = this;
+    while (true) {
+        cells.push_back(cell);
+        obj *next = cell->rest;
+        if (next == nil || next->isAtom() ||
+            static_cast<pair*>(next)->cached_hash.load(std::memory_order_relaxed))
+        {
+            h = next->hash();
+            break;
+        }
+        cell = static_cast<const pair*>(next);
+    }// while
+
+    for (auto c = cells.rbegin(); c != cells.rend(); ++c) {
+        h = hash_combine((*c)->first->hash(), h);
+        if (h == 0) { h = 1; }
+        (*c)->cached_hash.store(h, std::memory_order_relaxed);
+    }
+
+    return h;
+}// hash
 
-    pair *plist = dca<pair>(list);
-    return reverse_helper(plist->rest, new pair(plist->first, reversed));
-}
 
 pair *
 reverse(pair *list) {
-    return dca<pair>(reverse_helper(list, nil));
+    pair *reversed = nil;
+    for (obj *c = list; c != nil; c = dca<pair>(c)->rest) {
+        reversed = new pair(dca<pair>(c)->first, reversed);
+    }
+    return reversed;
 }// reverse
 
 
@@ -100,6 +302,9 @@ eval(obj* expr, context* ctx) {
 
         if (!expr->isList())  { throw malformed_expr(); }
 
+        budget::step();
+
+        trace_scope trace(expr, ctx);
 
         pair *pexpr = dca<pair>(expr);
         pair *expr_args = dca<pair>(pexpr->rest);
@@ -114,6 +319,7 @@ eval(obj* expr, context* ctx) {
         // first item in expr.
         obj *fun = eval(pexpr->first, ctx);
         if (!fun->isCallable()) { throw not_a_function(); }
+        trace.call(dca<callable>(fun));
 
         // If this is a macro, expand it and eval() the result
         if (dca<callable>(fun)->isMacro) {
@@ -138,43 +344,111 @@ eval(obj* expr, context* ctx) {
 
 
 obj*
-function::call(obj* actualArgs, context*) const {
-    context* ctx = new context(outer);
+callable::apply(obj * const *args, std::size_t n, context* outer) const {
+    pair *list = nil;
+    for (std::size_t i = n; i > 0; --i) { list = new pair(args[i - 1], list); }
+    return call(list, outer);
+}// callable::apply
+
+
+template<typename Bind>
+obj*
+function::run(context *caller, Bind bind) const {
+    profile_scope prof(this);
+    budget_frame frame;
+
+    heap_site site(heap_stats::of(this));
 
+    context* ctx = new context(outer->scope_for(caller));
+    bind(ctx);
+
+    // Evaluate the function body.
+    obj *result = nil;
+    for (obj *c = body; c != nil; c = static_cast<pair*>(c)->rest) {
+        result = eval(static_cast<pair*>(c)->first, ctx);
+    }
+
+    return result;
+}// run
+
+
+obj*
+function::call(obj* actualArgs, context* caller) const {
     pair *args = dca<pair>(actualArgs);
     assert(args);
 
     // Bind the argument values to their corresponding variables
     if (llen(formals) != llen(args)) { throw fn_arg_mismatch(); }
-    obj *curr_arg = args;
-    basic_each(
-        formals,
-        [&](obj* curr) {
-            ctx->define(dca<symbol>(curr)->text,
-                        dca<pair>(curr_arg)->first);
-            curr_arg = dca<pair>(curr_arg)->rest;
+
+    return run(caller, [&](context *ctx) {
+            obj *curr_arg = args;
+            basic_each(
+                formals,
+                [&](obj* curr) {
+                    ctx->define(dca<symbol>(curr)->text,
+                                dca<pair>(curr_arg)->first);
+                    curr_arg = dca<pair>(curr_arg)->rest;
+                });
         });
+}// call
 
-    // Evaluate the function body.
-    obj *result = nil;
-    basic_each(
-        body,
-        [&](obj* subexpr) {
-            result = eval(subexpr, ctx);
+
+obj*
+function::apply(obj * const *args, std::size_t n,
+                context* caller) const {
+    if (llen(formals) != n) { throw fn_arg_mismatch(); }
+
+    return run(caller, [&](context *ctx) {
+            std::size_t i = 0;
+            for (obj *f = formals; f != nil; f = static_cast<pair*>(f)->rest) {
+                ctx->define(dca<symbol>(static_cast<pair*>(f)->first)->text,
+                            args[i++]);
+            }
         });
+}// apply
 
-    return result;
-}// call
+
+// Builtins get their arguments in a vector, which they're allowed to
+// change (some erase the leading ones).  Rather than allocate one for
+// every call, each thread keeps one per level of nested builtin calls
+// and reuses it.  (The pool is a deque so that adding a level doesn't
+// move the vectors that are in use.)
+static thread_local std::deque<std::vector<obj*>> arg_pool;
+static thread_local std::size_t arg_depth = 0;
+
+namespace {
+struct pooled_args {
+    std::vector<obj*>& args;
+
+    pooled_args() :
+        args(arg_depth < arg_pool.size() ? arg_pool[arg_depth]
+                                         : arg_pool.emplace_back())
+    {
+        ++arg_depth;
+        args.clear();
+    }
+
+    ~pooled_args() {
+        --arg_depth;
+
+        // Don't hang on to the memory from an unusually long call.
+        if (args.capacity() > 4096) { std::vector<obj*>().swap(args); }
+    }
+};
+}// namespace
 
 
 obj*
 builtin::call(obj* actualArgs, context* outer) const {
+    profile_scope prof(this);
+
     std::size_t naa = llen(dca<pair>(actualArgs));
     if ( (!isVariadic && naa != nargs) || naa < nargs) {
         throw arg_count(nargs, naa);
     }
 
-    std::vector<obj*> args;
+    pooled_args pooled;
+    std::vector<obj*>& args = pooled.args;
     args.reserve(naa);
 
     for (obj *c = actualArgs; c != nil; c = dca<pair>(c)->rest) {
@@ -191,6 +465,28 @@ builtin::call(obj* actualArgs, context* outer) const {
 }// builtin::call
 
 
+obj*
+builtin::apply(obj * const *actual, std::size_t n, context* outer) const {
+    profile_scope prof(this);
+
+    if ( (!isVariadic && n != nargs) || n < nargs) {
+        throw arg_count(nargs, n);
+    }
+
+    pooled_args pooled;
+    pooled.args.assign(actual, actual + n);
+    try {
+        return code(pooled.args, outer);
+    } catch (error& err) {
+        // Only now do we need the arguments as a list.
+        std::vector<obj*> call(actual, actual + n);
+        call.insert(call.begin(), (obj*)this);
+        err.addtrace(printstr(vec2list(call), outer));
+        throw;
+    }
+}// builtin::apply
+
+
 std::string printstr(obj *o, const context *ctx, bool forDebugging) {
     // null is invalid but handling it here makes debugging easier
     if (!o) { return "{nullptr}"; }
@@ -199,7 +495,19 @@ std::string printstr(obj *o, const context *ctx, bool forDebugging) {
 
     if (o->isString()) {
         std::string result = o->str();
-        if (forDebugging) { result = "\"" + result + "\""; }
+        if (forDebugging) {
+            std::string quoted = "\"";
+            for (char c : result) {
+                switch (c) {
+                case '"':   quoted += "\\\""; break;
+                case '\\':  quoted += "\\\\"; break;
+                case '\n':  quoted += "\\n"; break;
+                case '\t':  quoted += "\\t"; break;
+                default:    quoted += c;
+                }
+            }
+            result = quoted + "\"";
+        }
         return result;
     }
 
@@ -219,7 +527,7 @@ std::string printstr(obj *o, const context *ctx, bool forDebugging) {
         bool first = true;
         for(obj *c = o; c != nil; c = dca<pair>(c)->rest) {
             if (!first) { result += ' '; }
-            result += printstr(dca<pair>(c)->first, ctx);
+            result += printstr(dca<pair>(c)->first, ctx, forDebugging);
             first = false;
         }
         result += ")";
@@ -232,12 +540,30 @@ std::string printstr(obj *o, const context *ctx, bool forDebugging) {
 }// printstr
 
 
+// Foreign buffers and lazy sequences can be walked like lists.
 void
 basic_each(obj *list, std::function<void(obj *)> actor) {
+    if (list->isAtom()) {
+        if (foreign_buffer *buf = dynamic_cast<foreign_buffer*>(list)) {
+            for (std::size_t i = 0; i < buf->size(); ++i) {
+                budget::step();
+                actor(new number(buf->value(i)));
+            }
+            return;
+        }
+
+        // Sequence sources charge their own steps.
+        if (sequence *seq = dynamic_cast<sequence*>(list)) {
+            seq->each([&](obj *item) { actor(item); return true; });
+            return;
+        }
+    }// if
+
     for (obj *curr = dca<pair>(list);
          curr != nil;
          curr = dca<pair>(curr)->rest)
     {
+        budget::step();
         actor(dca<pair>(curr)->first);
     }// for
 }// basic_each
@@ -247,6 +573,10 @@ obj *
 basic_nth(obj *list, int index) {
     if (index < 0) { return nil; }
 
+    if (foreign_buffer *buf = dynamic_cast<foreign_buffer*>(list)) {
+        return buf->at(index);
+    }
+
     if (list->isAtom()) { return nil; }
 
     for (pair *curr = dca<pair>(list);
@@ -263,26 +593,14 @@ basic_nth(obj *list, int index) {
 }// basic_nth
 
 
-// Convert a C++ std::vector<obj*> object to a list.
+// Convert a C++ std::vector<obj*> object to a list.  We build it
+// back to front so that each cell's 'rest' exists when it's created.
 pair *
 vec2list(const std::vector<obj*>& vec) {
     pair *result = nil;
-    pair *last = nil;
-
-    for (obj *item : vec) {
-        pair* next = new pair(item, nil);
-
-        if (result == nil) {
-            result = next;
-        } else {
-            // We directly write next to the 'rest' of the previous
-            // item.  This violates the constness of pair, which is
-            // bad, but it improves simplicity and performance, which
-            // is good.
-            *(const_cast<obj**>(&(last->rest))) = next;
-        }
-        last = next;
-    }// for
+    for (auto item = vec.rbegin(); item != vec.rend(); ++item) {
+        result = new pair(*item, result);
+    }
 
     return result;
 }// vec2list
@@ -293,8 +611,10 @@ vec2list(const std::vector<obj*>& vec) {
 pair *
 basic_map(pair *list, std::function<obj*(obj *)> actor) {
     std::vector<obj*> result;
+    result.reserve(llen(list));
 
     for (pair *curr = list; curr != nil; curr = dca<pair>(curr->rest)) {
+        budget::step();
         result.push_back(actor(curr->first));
     }// for
 
@@ -302,6 +622,203 @@ basic_map(pair *list, std::function<obj*(obj *)> actor) {
 }// map
 
 
+//
+// Channels
+//
+
+channel::channel(std::size_t cap) :
+    capacity(cap > 0 ? cap : 1),
+    slots(std::max(capacity, (std::size_t)2)),
+    cells(new cell[slots]),
+    send_pos(0), recv_pos(0),
+    waiting_readers(0), waiting_writers(0)
+{
+    for (std::size_t i = 0; i < slots; ++i) {
+        cells[i].seq.store(i, std::memory_order_relaxed);
+        cells[i].value = nil;
+    }
+}// channel::channel
+
+
+// Wake up whoever is parked on 'cv', but only take the lock if
+// someone could actually be there.  The fence pairs with the one in
+// park_until() so that either we see the waiter or it sees our
+// update.
+void
+channel::wake(std::atomic<int>& waiters, std::condition_variable& cv) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) == 0) { return; }
+
+    std::lock_guard<std::mutex> guard(park);
+    cv.notify_all();
+}// wake
+
+
+// Claim the next free cell and store 'value' in it.  Returns false
+// if the channel is full.
+bool
+channel::push(obj *value) {
+    std::size_t pos = send_pos.load(std::memory_order_relaxed);
+    cell *c;
+    while (true) {
+        // Only a one-value channel has more cells than capacity; its
+        // spare cell mustn't be used.  recv_pos may be stale, which
+        // only makes the channel look fuller than it is.
+        intptr_t held = (intptr_t)pos
+            - (intptr_t)recv_pos.load(std::memory_order_acquire);
+        if (held >= (intptr_t)capacity) {
+            std::size_t now = send_pos.load(std::memory_order_relaxed);
+            if (now == pos) { return false; }   // Full
+            pos = now;
+            continue;
+        }
+
+        c = &cells[pos % slots];
+        std::size_t seq = c->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (send_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;       // Full
+        } else {
+            pos = send_pos.load(std::memory_order_relaxed);
+        }
+    }// while
+
+    c->value = value;
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}// push
+
+
+// Take the oldest value out of its cell.  Returns false if the
+// channel is empty.
+bool
+channel::pop(obj *&value) {
+    std::size_t pos = recv_pos.load(std::memory_order_relaxed);
+    cell *c;
+    while (true) {
+        c = &cells[pos % slots];
+        std::size_t seq = c->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (recv_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;       // Empty
+        } else {
+            pos = recv_pos.load(std::memory_order_relaxed);
+        }
+    }// while
+
+    value = c->value;
+    c->seq.store(pos + slots, std::memory_order_release);
+    return true;
+}// pop
+
+
+bool
+channel::try_send(obj *value) {
+    if (!push(value)) { return false; }
+    wake(waiting_readers, readable);
+    return true;
+}// try_send
+
+
+bool
+channel::try_recv(obj *&value) {
+    if (!pop(value)) { return false; }
+    wake(waiting_writers, writable);
+    return true;
+}// try_recv
+
+
+// Spin briefly on 'attempt' and then sleep on 'cv' until it succeeds.
+// 'attempt' runs with 'park' held, so it mustn't wake anyone itself;
+// the caller does that afterward.
+//
+// If the thread has a budget, we wake up every so often to check it
+// since nothing will notify us when its deadline passes or it's
+// cancelled.
+template<typename Attempt>
+static void
+park_until(std::mutex& park, std::condition_variable& cv,
+           std::atomic<int>& waiters, Attempt attempt)
+{
+    static const std::chrono::milliseconds budget_poll(5);
+
+    for (int spin = 0; spin < 64; ++spin) {
+        if (attempt()) { return; }
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(park);
+    waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    try {
+        while (!attempt()) {
+            if (budget::limited()) {
+                cv.wait_for(lock, budget_poll);
+                budget::poll();
+            } else {
+                cv.wait(lock);
+            }
+        }
+    } catch (...) {
+        waiters.fetch_sub(1);
+        throw;
+    }
+    waiters.fetch_sub(1);
+}// park_until
+
+
+void
+channel::send(obj *value) {
+    park_until(park, writable, waiting_writers,
+               [&]() { return push(value); });
+    wake(waiting_readers, readable);
+}// send
+
+
+obj *
+channel::recv() {
+    obj *value = nil;
+    park_until(park, readable, waiting_readers,
+               [&]() { return pop(value); });
+    wake(waiting_writers, writable);
+    return value;
+}// recv
+
+
+bool
+channel::shareable(obj *o) {
+    while (true) {
+        if (o == nil) { return true; }
+
+        // Pairs are immutable so they're safe if their contents are.
+        // We walk the spine here and recurse on the elements.
+        if (pair *p = dynamic_cast<pair*>(o)) {
+            if (!shareable(p->first)) { return false; }
+            o = p->rest;
+            continue;
+        }
+
+        // Functions capture their defining context, which belongs to
+        // the sending interpreter.
+        return o->isString() || o->isSymbol()
+            || dynamic_cast<number*>(o) || dynamic_cast<builtin*>(o)
+            || dynamic_cast<channel*>(o) || dynamic_cast<foreign_buffer*>(o);
+    }// while
+}// shareable
+
+
 // Convert 'nm' from C++ naming convention to sic naming convention:
 //
 // 1. Trailing "_op" is dropped.
@@ -349,10 +866,30 @@ root_context() {
     // This may be set in repl.cpp; it's defined here for consistency
     tl->define("argv", nil);
 
+    // Scripts loaded by `require`
+    tl->define("loaded-modules", nil);
+
+    tl->define("stdin", stdin_port());
+    tl->define("stdout", stdout_port());
+    tl->define("stderr", stderr_port());
+
     return tl;
 }
 
 
+// Return a table mapping each builtin's (primary) Sic name to the
+// builtin.
+const std::map<std::string, callable*>&
+builtin_table() {
+    static const std::map<std::string, callable*> table = {
+#define BUILTIN_FULL(name, x1,x2,x3)    { fixname(#name), name },
+#include "sic_func.inc"
+    };
+
+    return table;
+}
+
+
 
 
 
@@ -436,42 +973,29 @@ read_string(std::istream& in) {
     return new string(s);
 }// read_string
 
+// Read a number.  If 'negate' is true, the caller has already
+// consumed a leading '-'.
+//
+// We only ever peek() ahead here; putback() isn't guaranteed to work
+// once the stream has refilled its buffer.
 static obj *
-read_number(std::istream& in) {
+read_number(std::istream& in, bool negate) {
     double n = 0;
 
-    bool negate = false;
-    if (in.peek() == '-') {
-        negate = true;
-        in.get();
-    }
-
-    char curr;
-    while(true) {
-        curr = in.get();
-        if (in.eof() || !isdigit(curr)) { break; }
-
+    while(isdigit(in.peek())) {
         n *= 10.0;
-        n += (double)(curr - '0');
+        n += (double)(in.get() - '0');
     }
 
-    if (in.eof() || curr != '.') {
-        if (!in.eof()) { in.putback(curr); }
+    if (in.peek() != '.') {
         return new number(negate ? -n : n);
     }
+    in.get();
 
     // Handle the fractional part if present
     double pos = 10.0;
-    while(true) {
-        curr = in.get();
-        if (in.eof()) { break; }
-
-        if (!isdigit(curr)) {
-            in.putback(curr);
-            break;
-        }
-
-        n += (double) (curr - '0') / pos;
+    while(isdigit(in.peek())) {
+        n += (double) (in.get() - '0') / pos;
         pos *= 10.0;
     }// while
 
@@ -479,13 +1003,18 @@ read_number(std::istream& in) {
 }// read_number
 
 static obj *
-read_word(std::istream& in, const std::function<bool(char c)>& validp) {
-    std::string result = "";
-
-    for (char c = in.peek(); !in.eof() && validp(c); c = in.peek()) {
+read_word(std::istream& in, const std::function<bool(char c)>& validp,
+          std::string result = "") {
+    for (int c = in.peek(); c != EOF && validp(c); c = in.peek()) {
         result += in.get();
     }// for
 
+    // E.g. a stray ')'; we'd never get past it.
+    if (result.empty()) {
+        throw syntax_error(std::string("Unknown token: '") +
+                           (char)in.peek() + "'");
+    }
+
     return $$(result);
 }// read_word
 
@@ -496,13 +1025,10 @@ read_word_or_number(std::istream& in, const std::function<bool(char c)>& validp)
     char minus = in.get();
     assert(minus == '-');
 
-    bool digit = isdigit(in.peek());
-    in.putback(minus);
-
-    if (digit) {
-        return read_number(in);
+    if (isdigit(in.peek())) {
+        return read_number(in, true);
     } else {
-        return read_word(in, validp);
+        return read_word(in, validp, "-");
     }
 }// read_word_or_number
 
@@ -540,7 +1066,7 @@ basic_read(std::istream& in) {
     }
     if (pk == '"')     { return read_string(in); }
     if (pk == '-')     { return read_word_or_number(in, isOperator); }
-    if (isdigit(pk))   { return read_number(in); }
+    if (isdigit(pk))   { return read_number(in, false); }
     if (isalpha(pk))   { return read_word(in, isWord); }
     if (ispunct(pk))   { return read_word(in, isOperator);}
 
@@ -554,6 +1080,250 @@ read(std::istream& in) {
     return basic_read(in);
 }
 
+
+
+//
+// Buffer reader
+//
+
+// Character classes for buffer_reader.  These must agree with the
+// rules in basic_read() above.
+enum : unsigned char {
+    CC_SPACE    = 0x01,
+    CC_DIGIT    = 0x02,
+    CC_ALPHA    = 0x04,
+    CC_WORD     = 0x08,     // Letters, digits and "-_?!"
+    CC_OP       = 0x10,     // Operator characters
+    CC_PUNCT    = 0x20,
+};
+
+static constexpr std::array<unsigned char, 256>
+make_char_classes() {
+    std::array<unsigned char, 256> cc = {};
+
+    for (unsigned char c : std::string_view(" \t\n\v\f\r")) { cc[c] |= CC_SPACE; }
+    for (int c = '0'; c <= '9'; ++c) { cc[c] |= CC_DIGIT | CC_WORD; }
+    for (int c = 'a'; c <= 'z'; ++c) { cc[c] |= CC_ALPHA | CC_WORD; }
+    for (int c = 'A'; c <= 'Z'; ++c) { cc[c] |= CC_ALPHA | CC_WORD; }
+    for (unsigned char c : std::string_view("-_?!")) { cc[c] |= CC_WORD; }
+    for (unsigned char c : std::string_view("-+=~!@$%^&*|\\//?<>~")) {
+        cc[c] |= CC_OP;
+    }
+    for (int c = 33; c < 127; ++c) {
+        if (!(cc[c] & (CC_DIGIT|CC_ALPHA))) { cc[c] |= CC_PUNCT; }
+    }
+
+    return cc;
+}
+
+static constexpr std::array<unsigned char, 256> char_classes =
+    make_char_classes();
+
+static inline bool
+is_cc(char c, unsigned char cls) {
+    return char_classes[(unsigned char)c] & cls;
+}
+
+
+void
+buffer_reader::skip_spaces() {
+    while (pos < end) {
+        if (is_cc(*pos, CC_SPACE)) {
+            ++pos;
+        } else if (*pos == ';' || *pos == '#') {
+            const char *eol = (const char *)memchr(pos, '\n', end - pos);
+            pos = eol ? eol + 1 : end;
+        } else {
+            break;
+        }
+    }// while
+}// skip_spaces
+
+
+// Return the longest run of characters in class 'cls' at the current
+// position.
+std::string_view
+buffer_reader::token(unsigned char cls) {
+    const char *start = pos;
+    while (pos < end && is_cc(*pos, cls)) { ++pos; }
+
+    if (pos == start) {
+        throw syntax_error(std::string("Unknown token: '") + *pos + "'");
+    }
+
+    return std::string_view(start, pos - start);
+}// token
+
+
+obj *
+buffer_reader::read_list() {
+    std::vector<obj*> result;
+
+    assert(*pos == '(');
+    ++pos;
+
+    while (true) {
+        skip_spaces();
+
+        if (pos >= end) { throw syntax_error("Unterminated list."); }
+        if (*pos == ')') {
+            ++pos;
+            break;
+        }
+
+        result.push_back(read());
+    }// while
+
+    return vec2list(result);
+}// read_list
+
+
+obj *
+buffer_reader::read_string() {
+    assert(*pos == '"');
+    ++pos;
+
+    const char *close = (const char *)memchr(pos, '"', end - pos);
+    const char *bs = close
+        ? (const char *)memchr(pos, '\\', close - pos)
+        : nullptr;
+
+    // Common case: no escapes so we can just take the whole thing.
+    if (close && !bs) {
+        std::string_view s(pos, close - pos);
+        pos = close + 1;
+        return new string(std::string(s));
+    }
+
+    std::string s;
+    while (true) {
+        if (pos >= end) { throw syntax_error("Unterminated string!"); }
+
+        char c = *pos++;
+        if (c == '"') { break; }
+        if (c == '\\') {
+            if (pos >= end) { throw syntax_error("Unterminated string!"); }
+
+            c = *pos++;
+            switch(c) {
+            case 'a':   s += "\a"; break;
+            case 'b':   s += "\b"; break;
+            case 'f':   s += "\f"; break;
+            case 'n':   s += "\n"; break;
+            case 't':   s += "\t"; break;
+            case 'v':   s += "\v"; break;
+            default:    s += c;
+            }
+            continue;
+        }// if
+
+        s += c;
+    }// while
+
+    return new string(s);
+}// read_string
+
+
+obj *
+buffer_reader::read_number() {
+    double n = 0;
+
+#if defined(__cpp_lib_to_chars)
+    auto [next, ec] = std::from_chars(pos, end, n, std::chars_format::fixed);
+    bool ok = ec == std::errc();
+#else
+    // Floating-point from_chars is missing from some standard libraries
+    // (e.g. libc++ before LLVM 17).  Instead, we find the end of the
+    // number ourselves (it has the same form: an optional '-', digits
+    // and an optional fraction) and give strtod a terminated copy.
+    const char *next = pos;
+    if (next < end && *next == '-') { ++next; }
+    while (next < end && is_cc(*next, CC_DIGIT)) { ++next; }
+    if (next < end && *next == '.') {
+        ++next;
+        while (next < end && is_cc(*next, CC_DIGIT)) { ++next; }
+    }
+
+    const std::string text(pos, next);
+    char *stop = nullptr;
+    errno = 0;
+    n = strtod(text.c_str(), &stop);
+    bool ok = stop == text.c_str() + text.size() && errno != ERANGE;
+#endif
+
+    if (!ok) {
+        throw syntax_error("Invalid number: '" +
+                           std::string(pos, std::min(end, pos + 20)) + "'");
+    }
+
+    pos = next;
+    return new number(n);
+}// read_number
+
+
+obj *
+buffer_reader::read() {
+    skip_spaces();
+    if (pos >= end) { return nullptr; }
+
+    char pk = *pos;
+
+    if (pk == '(')      { return read_list(); }
+    if (pk == '\'')     {
+        ++pos;
+        obj *quoted = read();
+        if (!quoted) { throw syntax_error("Nothing to quote."); }
+        return $(quote, quoted);
+    }
+    if (pk == '"')      { return read_string(); }
+    if (pk == '-') {
+        bool digit = pos + 1 < end && is_cc(pos[1], CC_DIGIT);
+        return digit ? read_number() : $$(token(CC_OP));
+    }
+    if (is_cc(pk, CC_DIGIT))    { return read_number(); }
+    if (is_cc(pk, CC_ALPHA))    { return $$(token(CC_WORD)); }
+    if (is_cc(pk, CC_PUNCT))    { return $$(token(CC_OP)); }
+
+    throw syntax_error(std::string("Unknown token: '") + pk + "'");
+}// read
+
+
+//
+// Mapped files
+//
+
+mapped_file::mapped_file(const std::string& path) : data(nullptr), size(0) {
+    // Check before opening; opening a FIFO can block.
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+        throw error("Unable to map '" + path + "': not a regular file.");
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) { ::close(fd); }
+        throw error("Unable to open '" + path + "': " + strerror(errno));
+    }
+
+    size = (std::size_t)st.st_size;
+    if (size > 0) {
+        void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            ::close(fd);
+            throw error("Unable to map '" + path + "': " + strerror(errno));
+        }
+
+        madvise(m, size, MADV_SEQUENTIAL);
+        data = (const char *)m;
+    }// if
+
+    ::close(fd);
+}// mapped_file::mapped_file
+
+mapped_file::~mapped_file() {
+    if (data) { munmap((void *)data, size); }
+}
+
 // Return a printable represention of the object.  This a wrapper
 // around `printstr()` and is mostly intended to be called from inside
 // a debugger.
@@ -4,14 +4,28 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <exception>
 #include <map>
+#include <unordered_map>
+#include <list>
 #include <vector>
 #include <typeinfo>
 #include <functional>
 #include <cassert>
 #include <cmath>
 #include <sstream>
+#include <istream>
+#include <ostream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 
 
 namespace sic {
@@ -97,6 +111,24 @@ public:
     virtual const char *id() const override { return "syntax_error"; }
 };
 
+class io_error : public error {
+public:
+    io_error(const std::string& msg) : error(msg) {}
+    virtual const char *id() const override { return "io_error"; }
+};
+
+class budget_exceeded : public error {
+public:
+    budget_exceeded(const std::string& msg) : error(msg) {}
+    virtual const char *id() const override { return "budget_exceeded"; }
+};
+
+class frozen_context : public error {
+public:
+    frozen_context(const std::string& nm) : error(nm) {}
+    virtual const char *id() const override { return "frozen_context"; }
+};
+
 class assertion_failure : public error {
 public:
     assertion_failure(const std::string& msg) : error(msg) {}
@@ -114,6 +146,8 @@ class pair;
 class symbol;
 class callable;
 class context;
+class input_port;
+class output_port;
 
 extern pair *reverse(pair *list);
 extern std::size_t llen(obj *lst);
@@ -126,6 +160,25 @@ extern obj *basic_nth(obj *list, int index);
 extern pair *vec2list(const std::vector<obj*>& vec);
 extern obj* read(std::istream& in);
 extern context *root_context();
+extern const std::map<std::string, callable*>& builtin_table();
+extern void save_image(context *root, const std::string& path);
+extern void load_image(context *root, const std::string& path);
+extern std::string encode_value(obj *value, context *root);
+extern obj *decode_value(std::string_view data, context *root);
+extern void save_value(const std::string& path, obj *value, context *root);
+extern obj *load_value(const std::string& path, context *root);
+extern obj *expand(obj *expr, context *ctx);
+extern obj *load_module(context *root, const std::string& path);
+extern obj *read_json(std::streambuf *in);     // nullptr at end of input
+extern obj *parse_json(std::string_view text);
+extern void write_json(std::string& out, obj *value);
+extern obj *read_csv_row(std::streambuf *in, char sep);
+extern obj *parse_csv(std::string_view text, char sep);
+extern void write_csv_row(std::string& out, obj *row, char sep);
+extern input_port *stdin_port();
+extern output_port *stdout_port();
+extern output_port *stderr_port();
+extern std::string callable_name(const callable *fn, const context *ctx);
 extern const char *po(obj *o);
 extern const char *po2(obj *o, const context *ctx);
 
@@ -149,15 +202,191 @@ T* dca(obj *o) {
 }
 
 
+// Allocation accounting.  Each thread counts the objects it allocates
+// by type and by the Sic function (i.e. `function`, not builtin) that
+// was running at the time; allocations made outside of any function
+// are counted as top-level.
+class heap_stats {
+public:
+    enum kind { PAIR, NUMBER, STRING, CONTEXT, FUNCTION, KINDS };
+
+    struct counts {
+        uint64_t objects[KINDS];
+        uint64_t bytes[KINDS];
+    };
+
+private:
+    inline static thread_local counts toplevel;
+    inline static thread_local counts *site = nullptr;
+    inline static thread_local uint64_t bytes_allocated = 0;
+
+    // The last function looked up by of(), since it's usually called
+    // for the same one again (e.g. recursion).
+    inline static thread_local const callable *last_fn = nullptr;
+    inline static thread_local counts *last_counts = nullptr;
+
+    static counts *lookup(const callable *fn);
+
+    friend class heap_site;
+
+public:
+    static void note(kind k, std::size_t bytes) {
+        counts *c = site ? site : &toplevel;
+        ++c->objects[k];
+        c->bytes[k] += bytes;
+        bytes_allocated += bytes;
+    }
+
+    // Bytes allocated by this thread so far.
+    static uint64_t allocated() { return bytes_allocated; }
+
+    // The counters for function 'fn' on this thread, created on first
+    // use.  Functions can be shared between threads so they can't
+    // hold on to these themselves.
+    static counts *of(const callable *fn) {
+        if (fn != last_fn) {
+            last_counts = lookup(fn);
+            last_fn = fn;
+        }
+        return last_counts;
+    }
+
+    // Return the counters for this thread; the first entry (with a
+    // null callable) is the top level.
+    static std::vector<std::pair<const callable*, const counts*>> all();
+
+    // Write a table of allocations per function, biggest first.
+    static void report(std::ostream& out, const context *ctx);
+
+    static const char *kind_name(kind k);
+};
+
+// Attributes allocations to 'c' until destroyed.
+class heap_site {
+    heap_stats::counts * const saved;
+public:
+    explicit heap_site(heap_stats::counts *c) : saved(heap_stats::site) {
+        heap_stats::site = c;
+    }
+    ~heap_site() { heap_stats::site = saved; }
+};
+
+
+// Limits on the evaluation done by this thread while the budget
+// exists: the number of steps (compound expressions evaluated and loop
+// iterations), the depth of Sic function calls, a deadline, the bytes
+// allocated and a flag that another thread can set to cancel.  Going
+// over any of them throws budget_exceeded.  The deadline, memory and
+// cancel flag are only looked at every CHECK_INTERVAL steps.
+//
+// Budgets nest: a new budget starts with what's left of the enclosing
+// one and its steps are charged to it.
+class budget {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr uint64_t UNLIMITED = UINT64_MAX;
+    static constexpr unsigned CHECK_INTERVAL = 1024;
+
+private:
+    inline static thread_local budget *active = nullptr;
+
+    budget * const outer;
+    uint64_t steps_left, steps_used;
+    unsigned depth, depth_limit;
+    clock::time_point deadline;
+    uint64_t memory_limit;              // In terms of heap_stats::allocated()
+    const std::atomic<bool> *cancelled;
+    unsigned until_check;
+
+    void check();
+
+    friend class budget_frame;
+
+public:
+    budget();
+    ~budget();
+    budget(const budget&) = delete;
+
+    // Each of these can only tighten the budget.
+    budget& steps(uint64_t n);
+    budget& max_depth(unsigned n);
+    budget& timeout(clock::duration d);
+    budget& memory(uint64_t bytes);
+    budget& cancel_flag(const std::atomic<bool> *flag);
+
+    uint64_t used() const { return steps_used; }
+
+    // Charge one step to this thread's budget, if it has one.
+    static void step() {
+        if (budget *b = active) { b->charge(); }
+    }
+
+    // For code that waits rather than steps: whether this thread has
+    // a budget, and a check of its deadline, cancel flag and memory
+    // limit right now.
+    static bool limited() { return active != nullptr; }
+    static void poll() {
+        if (budget *b = active) { b->check(); }
+    }
+
+    void charge() {
+        if (steps_left == 0) { throw budget_exceeded("out of steps"); }
+        --steps_left;
+        ++steps_used;
+        if (--until_check == 0) { check(); }
+    }
+};
+
+// Counts a Sic function call against the depth limit while it exists.
+class budget_frame {
+    budget * const b;
+public:
+    budget_frame() : b(budget::active) {
+        if (b && ++b->depth > b->depth_limit) {
+            --b->depth;
+            throw budget_exceeded("call depth limit reached");
+        }
+    }
+    ~budget_frame() { if (b) { --b->depth; } }
+};
+
+
+// A context can be frozen once it's set up (e.g. a root context after
+// loading a prelude).  After that it can't be changed but it can be
+// forked: a fork sees all of its bindings but keeps its own changes
+// in a separate map, so forks are cheap to make and don't affect each
+// other.  Since a frozen context never changes, its forks can be used
+// from different threads (each fork by one thread at a time).
 class context {
     std::map<std::string, obj*> items;
+    context * const base;       // The frozen context we're a fork of
+    std::atomic<bool> frozen = false;   // Forking may freeze us
+
+    void writable(const std::string& name) const {
+        if (frozen) { throw frozen_context(name); }
+    }
+
+    // The value slot for 'name' here or in a context we fork.
+    obj * const *lookup(const std::string& name) const {
+        for (const context *c = this; c; c = c->base) {
+            auto found = c->items.find(name);
+            if (found != c->items.end()) { return &found->second; }
+        }
+        return nullptr;
+    }
+
+    context(context *p, context *b) : base(b), parent(p) {
+        heap_stats::note(heap_stats::CONTEXT, sizeof(context));
+    }
+
 public:
     context * const parent;
     context(context &) = delete;
-    context(context *p) : parent(p) {}
+    context(context *p) : context(p, nullptr) {}
 
-    bool has(const std::string& name) const { return items.count(name) > 0; }
+    bool has(const std::string& name) const { return lookup(name) != nullptr; }
     void define(const std::string& name, obj* value) {
+        writable(name);
         if (has(name)) { throw redefined_name(name); }
         items[name] = value;
     }
@@ -165,6 +394,7 @@ public:
     // Store 'value' at 'name'; throws undefined_name if name has not
     // been defined.
     void set(const std::string& name, obj* value) {
+        writable(name);
         if(!has(name)) {
             if (!parent) { throw undefined_name(name); }
             parent->set(name, value);
@@ -175,6 +405,7 @@ public:
     // Like set, but will create 'name' if it's undefined IF this is
     // the toplevel context.  Convenience method.
     void tl_set(const std::string& name, obj *value) {
+        writable(name);
         if (parent) { set(name, value); }
         items[name] = value;
     }
@@ -184,7 +415,7 @@ public:
     }
 
     obj* get(const std::string& name) const {
-        if (has(name))  { return items.at(name); }
+        if (obj * const *value = lookup(name)) { return *value; }
         if (parent)     { return parent->get(name); }
         throw undefined_name(name);
     }
@@ -195,6 +426,11 @@ public:
             if (item.second == o) { return item.first; }
         }
 
+        if (base) {
+            std::string name = base->name_of(o);
+            if (!name.empty()) { return name; }
+        }
+
         if (parent) { return parent->name_of(o); }
 
         return "";
@@ -203,6 +439,49 @@ public:
     context *root() {
         return parent ? parent->root() : this;
     }
+
+    // Stop all further changes to this context.
+    void freeze() { frozen = true; }
+    bool is_frozen() const { return frozen; }
+
+    // Return a new, writable fork of this context, freezing it first
+    // if needed.  This doesn't copy anything.
+    context *fork() {
+        if (!frozen) { freeze(); }
+        return new context(parent, this);
+    }
+
+    // The context that a function whose scope is this one should run
+    // in when called from 'caller'.  Functions defined at the top of
+    // a frozen context run in the caller's fork of it (if there is
+    // one) so that they see (and change) that fork's globals.
+    context *scope_for(context *caller) {
+        if (!frozen) { return this; }
+
+        for (context *c = caller; c; c = c->parent) {
+            for (const context *b = c->base; b; b = b->base) {
+                if (b == this) { return c; }
+            }
+        }
+        return this;
+    }
+
+    // Our own bindings; a fork's inherited ones are in the context it
+    // forked.
+    const std::map<std::string, obj*>& bindings() const { return items; }
+
+    // Every binding visible here, including a fork's inherited ones
+    // (where ours take precedence).
+    std::map<std::string, obj*> all_bindings() const {
+        if (!base) { return items; }
+
+        std::map<std::string, obj*> all = base->all_bindings();
+        for (const auto& item : items) { all[item.first] = item.second; }
+        return all;
+    }
+
+    // The context we're a fork of, or nullptr.
+    context *forked_from() const { return base; }
 };
 
 class obj {
@@ -216,25 +495,63 @@ public:
     virtual bool isMacro()      const { return false; }
     virtual bool equals(obj *o) const { return o == this; }
 
+    // Consistent with equals(): objects that are equal have the same
+    // hash.  By default, both go by identity.
+    virtual std::size_t hash()  const {
+        return std::hash<const void*>()(this);
+    }
+
     virtual std::string str()   const = 0;
 };
 
+// For keying hashed containers on Sic values by structure.
+struct obj_hash {
+    std::size_t operator()(const obj *o) const { return o->hash(); }
+};
+struct obj_equal {
+    bool operator()(obj *a, obj *b) const { return a->equals(b); }
+};
+
+// Strings share their characters: a slice of a string (e.g. from
+// `substring` or `split`) points into the same buffer, which lives
+// as long as any string using it.
 class string : public obj {
+    std::shared_ptr<const std::string> storage;
+
 public:
-    const std::string contents;
+    const std::string_view contents;
+
+    explicit string(std::string s)
+        : storage(std::make_shared<const std::string>(std::move(s))),
+          contents(*storage) {
+        heap_stats::note(heap_stats::STRING,
+                         sizeof(string) + storage->capacity());
+    }
+
+    // The characters of 'base' from 'pos' to 'pos + len' (clipped to
+    // its end) without copying them.
+    string(const string *base, std::size_t pos, std::size_t len)
+        : storage(base->storage),
+          contents(base->contents.substr(std::min(pos, base->contents.size()),
+                                         len)) {
+        heap_stats::note(heap_stats::STRING, sizeof(string));
+    }
 
-    explicit string(std::string s) : contents(s) {}
     virtual bool isString()     const override { return true; }
     virtual bool equals(obj* o) const override {
         string *os = dynamic_cast<string*>(o);
         return os && os->contents == contents;
     }
-    virtual std::string str() const override { return contents; }
+    virtual std::size_t hash() const override {
+        return std::hash<std::string_view>()(contents);
+    }
+    virtual std::string str() const override { return std::string(contents); }
 };
 
 class symbol : public obj {
 private:
-    inline static std::map<std::string, symbol*> symbols;
+    inline static std::map<std::string, symbol*, std::less<>> symbols;
+    inline static std::mutex symbols_lock;  // Interpreters may share it
 
     explicit symbol(std::string& v) : text(v) {}
 
@@ -243,9 +560,16 @@ public:
     virtual bool isSymbol()     const override { return true; }
     virtual std::string str()   const override { return text; }
 
-    static symbol* intern(std::string s) {
-        if (symbols.count(s) == 0) { symbols[s] = new symbol(s); }
-        return symbols[s];
+    static symbol* intern(std::string_view s) {
+        std::lock_guard<std::mutex> guard(symbols_lock);
+
+        auto found = symbols.find(s);
+        if (found != symbols.end()) { return found->second; }
+
+        std::string name(s);
+        symbol *sym = new symbol(name);
+        symbols[name] = sym;
+        return sym;
     }
 };
 
@@ -255,8 +579,12 @@ class number : public obj {
 public:
     const double val;
     
-    explicit number(long l) : val((double)l) {}
-    explicit number(double d) : val(d) {}
+    explicit number(long l) : val((double)l) {
+        heap_stats::note(heap_stats::NUMBER, sizeof(number));
+    }
+    explicit number(double d) : val(d) {
+        heap_stats::note(heap_stats::NUMBER, sizeof(number));
+    }
     
     virtual std::string str() const override {
         if (val == trunc(val)) { return std::to_string((long long )val); }
@@ -267,38 +595,65 @@ public:
         number *on = dynamic_cast<number*>(o);
         return on && on->val == val;
     }
-    
+
+    virtual std::size_t hash() const override {
+        return std::hash<double>()(val);
+    }
+
 };
 
 class pair : public obj {
+    // Structural hash, computed on demand; 0 means not yet.  Pairs
+    // are immutable once built so it never goes stale.
+    mutable std::atomic<std::size_t> cached_hash;
+
+    // The length of the list starting here or 0 if it's not a proper
+    // list; 'rest' already exists when we're built so this is just one
+    // step.
+    static std::size_t shape(obj *d) {
+        if (d == nil) { return 1; }
+        if (d->isAtom()) { return 0; }
+        std::size_t len = static_cast<pair*>(d)->length;
+        return len ? len + 1 : 0;
+    }
+
+protected:
+    // For nil, which is its own 'rest'.
+    pair(obj *a, obj *d, std::size_t len)
+        : cached_hash(0), length(len), first(a), rest(d) {}
+
 public:
+    const std::size_t length;
     obj * const first;
     obj * const rest;
 
-    explicit pair(obj *a, obj *d) : first(a), rest(d) {}
+    explicit pair(obj *a, obj *d)
+        : cached_hash(0), length(shape(d)), first(a), rest(d) {
+        heap_stats::note(heap_stats::PAIR, sizeof(pair));
+    }
     
     virtual bool isAtom() const override { return false; }
-    virtual bool isList() const override { return rest == nil || rest->isList(); }
+    virtual bool isList() const override { return length > 0; }
 //    pair *next() const { return dca<pair>(rest); }
     virtual std::string str() const override {
         return std::string("(") + first->str() + "." + rest->str() + ")";
     }
 
-    virtual bool equals(obj* o) const override {
-        pair *op = dynamic_cast<pair*>(o);
-        return op && first->equals(op->first) && rest->equals(op->rest);
-    }
-    
+    // Both walk the spine iteratively so long lists don't use up the
+    // C++ stack; only nested lists recurse.
+    virtual bool equals(obj* o) const override;
+    virtual std::size_t hash() const override;
 };
 
 class nilClass : public pair {
 private:    
     inline static nilClass *instance = nullptr;
 
-    explicit nilClass() : pair(this, this) {}
+    explicit nilClass() : pair(this, this, 0) {}
 
 public:
     virtual std::string str() const override { return "'()"; }
+    virtual bool isList() const override { return true; }
     virtual bool isTrue() const override { return false; }
 
     static nilClass *getInstance() {
@@ -307,6 +662,7 @@ public:
     }
 
     virtual bool equals(obj* o) const override { return o == this; }
+    virtual std::size_t hash() const override { return 0x6e696cu; }
 };
 
 
@@ -321,23 +677,39 @@ public:
     explicit callable(bool m) : isMacro(m) {}
 
     virtual obj* call(obj* actualArgs, context* outer) const = 0;
+
+    // Call with the (already evaluated) arguments 'args[0..n)'.  This
+    // lets native code such as `map` skip building an argument list;
+    // the default just builds one and calls call().
+    virtual obj* apply(obj * const *args, std::size_t n, context* outer) const;
 };
 
 class function : public callable {
     pair *formals, *body;
     context *outer;
+
+    friend class image_writer;
+
+    // Run the body in a new context after 'bind' has defined the
+    // arguments in it.
+    template<typename Bind> obj* run(context *caller, Bind bind) const;
+
 public:
     explicit function(pair* f, pair* b, context *ctx, bool m)
-        : callable(m), formals(f), body(b), outer(ctx) {}
+        : callable(m), formals(f), body(b), outer(ctx) {
+        heap_stats::note(heap_stats::FUNCTION, sizeof(function));
+    }
     virtual obj* call(obj* actualArgs, context* outer) const override;
+    virtual obj* apply(obj * const *args, std::size_t n,
+                       context* outer) const override;
 };
 
 
 class builtin : public callable {
 public:
     // The callback takes its argument by reference; this is a
-    // compromise for performance.  We assume that the caller will
-    // discard the underlying vector after the call.
+    // compromise for performance.  The callback may change the vector
+    // but mustn't keep a reference to it: it's reused for later calls.
     using Callback = std::function<obj*(std::vector<obj*>&, context*)>;
 
 private:
@@ -350,9 +722,326 @@ public:
         callable(ismacro), code(c),  nargs(na), isVariadic(isvar) {}
 
     virtual obj* call(obj* actualArgs, context* outer) const override;
+    virtual obj* apply(obj * const *args, std::size_t n,
+                       context* outer) const override;
+};
+
+
+// Wraps a callable with a cache of its results, keyed on the argument
+// list and compared structurally (see obj_hash and obj_equal).  If
+// 'capacity' is non-zero, the least recently used result is dropped
+// to make room once the cache is full.
+//
+// The cache is locked so one memoized function can be called from
+// several threads.  The lock isn't held while the function runs, so
+// two threads may both compute a missing result (one of them wins).
+class memoized : public callable {
+    using entry = std::pair<obj*, obj*>;    // Arguments, result
+
+    callable * const fn;
+    const std::size_t capacity;
+
+    // Most recently used first; 'index' points into it.  All of this
+    // is guarded by 'lock'.
+    mutable std::mutex lock;
+    mutable std::list<entry> lru;
+    mutable std::unordered_map<obj*, std::list<entry>::iterator,
+                               obj_hash, obj_equal> index;
+    mutable uint64_t hit_count, miss_count;
+
+public:
+    memoized(callable *f, std::size_t cap)
+        : callable(f->isMacro), fn(f), capacity(cap),
+          hit_count(0), miss_count(0) {}
+
+    virtual obj* call(obj* actualArgs, context* outer) const override;
+
+    callable *wrapped() const { return fn; }
+    std::size_t max_size() const { return capacity; }   // 0 if unbounded
+
+    uint64_t hits() const {
+        std::lock_guard<std::mutex> hold(lock);
+        return hit_count;
+    }
+    uint64_t misses() const {
+        std::lock_guard<std::mutex> hold(lock);
+        return miss_count;
+    }
+    std::size_t size() const {
+        std::lock_guard<std::mutex> hold(lock);
+        return index.size();
+    }
+
+    // Forget all results and reset the counters.
+    void clear();
+};
+
+
+// Bounded multi-producer/multi-consumer queue for passing values
+// between interpreters (e.g. each running in its own thread with its
+// own root context).
+//
+// The queue itself is lock-free (it's Dmitry Vyukov's bounded MPMC
+// ring); the mutex is only used to park threads that have to wait
+// for space or for a value.  Values are passed as-is, so they should
+// be immutable (see `shareable()`).
+class channel : public obj {
+    struct cell {
+        std::atomic<std::size_t> seq;
+        obj *value;
+    };
+
+    // The ring always has at least two cells: with only one, "full"
+    // and "empty on the next lap" look the same.  'capacity' is the
+    // bound that callers see.
+    const std::size_t capacity;
+    const std::size_t slots;
+    std::unique_ptr<cell[]> cells;
+
+    alignas(64) std::atomic<std::size_t> send_pos;
+    alignas(64) std::atomic<std::size_t> recv_pos;
+
+    // Blocking support
+    std::mutex park;
+    std::condition_variable readable, writable;
+    std::atomic<int> waiting_readers, waiting_writers;
+
+    bool push(obj *value);      // try_send and try_recv without the wake
+    bool pop(obj *&value);
+    void wake(std::atomic<int>& waiters, std::condition_variable& cv);
+
+public:
+    explicit channel(std::size_t cap);
+    channel(const channel&) = delete;
+
+    virtual std::string str() const override { return "<channel>"; }
+
+    bool try_send(obj *value);
+    bool try_recv(obj *&value);
+    void send(obj *value);      // Blocks while the channel is full
+    obj *recv();                // Blocks while the channel is empty
+
+    // Test if 'o' can be safely seen by another interpreter,
+    // i.e. it's built entirely from immutable objects.
+    static bool shareable(obj *o);
 };
 
 
+// A read-only view of an array owned by the host: 'size()' elements
+// of some numeric type starting at 'data'.  Nothing is copied;
+// elements are converted to numbers as they're read.  The host must
+// keep the memory alive (and should keep it unchanged) while Sic can
+// see it.
+//
+// If given, 'release' is called when the buffer and every slice of
+// it have been deleted.  (Sic itself never frees objects so this only
+// happens if the host deletes them.)
+class foreign_buffer : public obj {
+public:
+    enum element { INT8, UINT8, INT16, UINT16, INT32, UINT32, INT64, UINT64,
+                   FLOAT, DOUBLE };
+    using release_fn = std::function<void()>;
+
+private:
+    struct owner {
+        release_fn release;
+        ~owner() { if (release) { release(); } }
+    };
+
+    std::shared_ptr<owner> keeper;      // Shared with slices
+    const char * const data;
+    const std::size_t length;
+    const element elem;
+
+    foreign_buffer(std::shared_ptr<owner> k, const char *d, std::size_t len,
+                   element e)
+        : keeper(k), data(d), length(len), elem(e) {}
+
+    template<typename T> static constexpr element element_of() {
+        if constexpr (std::is_same_v<T, float>) {
+            return FLOAT;
+        } else if constexpr (std::is_same_v<T, double>) {
+            return DOUBLE;
+        } else {
+            static_assert(std::is_integral_v<T> && sizeof(T) <= 8,
+                          "unsupported element type");
+            constexpr bool s = std::is_signed_v<T>;
+            switch (sizeof(T)) {
+            case 1:     return s ? INT8  : UINT8;
+            case 2:     return s ? INT16 : UINT16;
+            case 4:     return s ? INT32 : UINT32;
+            default:    return s ? INT64 : UINT64;
+            }
+        }
+    }
+
+public:
+    foreign_buffer(const void *d, std::size_t len, element e,
+                   release_fn release = nullptr)
+        : keeper(new owner{release}),
+          data(static_cast<const char*>(d)), length(len), elem(e) {}
+
+    // Deduce the element type from the pointer.
+    template<typename T>
+    foreign_buffer(const T *d, std::size_t len, release_fn release = nullptr)
+        : foreign_buffer(static_cast<const void*>(d), len, element_of<T>(),
+                         release) {}
+
+    std::size_t size() const    { return length; }
+    element type() const        { return elem; }
+
+    // Element 'i' as a double; 'i' is not checked.
+    double value(std::size_t i) const;
+
+    // Element 'i' as a number or nil if 'i' is out of range.
+    obj *at(long i) const;
+
+    // The elements from 'from' up to (but not including) 'to', clipped
+    // to the buffer's bounds.  Shares this buffer's memory.
+    foreign_buffer *slice(long from, long to) const;
+
+    static const char *type_name(element e);
+    static std::size_t type_size(element e);
+
+    virtual std::string str() const override;
+};
+
+
+// A lazy sequence: a source of values (a range, an existing list or
+// buffer, or the expressions in a file) followed by any number of
+// map, filter and take stages.
+// Nothing is computed until a terminal operation (`each`, `fold`,
+// `to-list`, ...) runs the whole pipeline in one pass, so no
+// intermediate lists are built.  This does not make a pipeline run in
+// constant memory, though: a range makes a new number for each value
+// and every call to a stage's function makes a new context, and since
+// nothing is ever freed these add up over a long run.
+//
+// Stages keep the context they were created in to call their
+// functions with.  Sequences can be run any number of times.
+class sequence : public obj {
+public:
+    // What a stage is made of, so that images can save it and build
+    // it again.  Which fields are used depends on 'kind'.
+    struct parts {
+        enum { RANGE, ITEMS, MAP, FILTER, TAKE, DROP, FORMS } kind;
+        obj *source = nil;      // Previous stage, items or input
+        callable *fn = nullptr; // MAP and FILTER
+        context *ctx = nullptr; // MAP and FILTER
+        double start = 0, end = 0, step = 0;    // RANGE
+        std::size_t count = 0;  // TAKE and DROP
+    };
+
+    // Call 'sink' on each value in turn until it returns false.
+    // Returns false if the sink stopped early.
+    virtual bool each(const std::function<bool(obj*)>& sink) const = 0;
+
+    virtual parts describe() const = 0;
+    static sequence *rebuild(const parts& p);
+
+    // Numbers from 'start' up to (but not including) 'end' by
+    // 'step'.  'end' may be infinite.
+    static sequence *range(double start, double end, double step);
+
+    // The items of a list or buffer.
+    static sequence *of(obj *items);
+
+    // The expressions read from an input port or the file at a path
+    // (see `read-forms`).
+    static sequence *forms(obj *input);
+
+    sequence *map(callable *fn, context *ctx) const;
+    sequence *filter(callable *fn, context *ctx) const;
+    sequence *take(std::size_t n) const;
+    sequence *drop(std::size_t n) const;
+
+    virtual std::string str() const override { return "<sequence>"; }
+};
+
+
+// A source of input: a file or an existing stream such as std::cin.
+// Lines are read into a buffer that is reused from one line to the
+// next so that reading a file line by line doesn't need memory
+// proportional to its size.
+class input_port : public obj {
+    std::unique_ptr<std::istream> owned;
+    std::istream *in;
+    std::string buffer;
+
+public:
+    explicit input_port(std::istream& s) : in(&s) {}
+    explicit input_port(const std::string& path);  // Throws io_error
+    input_port(const input_port&) = delete;
+
+    virtual std::string str() const override { return "<input-port>"; }
+
+    // Read the next line into line(); returns false at end of input.
+    bool read_line();
+    const std::string& line() const { return buffer; }
+
+    // Read the next expression; returns nullptr at end of input.
+    obj *read_form();
+
+    // The underlying stream; use this to read from C++.  Throws
+    // io_error if the port is closed.
+    std::istream& stream();
+
+    void close();
+};
+
+
+// A destination for output: a file or an existing stream such as
+// std::cout.  Output is collected in a buffer of user-specified size
+// and only written to the underlying stream when the buffer fills or
+// the port is flushed.  A buffer size of zero writes through.
+//
+// Open ports are flushed at exit.
+class output_port : public obj {
+    class port_buf : public std::streambuf {
+        std::vector<char> space;
+        std::ostream *sink;
+
+        void drain();
+    protected:
+        virtual int overflow(int c) override;
+        virtual int sync() override;
+        virtual std::streamsize xsputn(const char *s,
+                                       std::streamsize n) override;
+    public:
+        port_buf(std::ostream *out, std::size_t size);
+        void resize(std::size_t size);
+        void detach() { drain(); sink = nullptr; }
+    };
+
+    std::unique_ptr<std::ostream> owned;
+    port_buf buf;
+    std::ostream out;
+    std::mutex lock;
+
+public:
+    static constexpr std::size_t default_buffer_size = 64 * 1024;
+
+    explicit output_port(std::ostream& s,
+                         std::size_t size = default_buffer_size);
+    output_port(const std::string& path,           // Throws io_error
+                std::size_t size = default_buffer_size);
+    output_port(const output_port&) = delete;
+
+    virtual std::string str() const override { return "<output-port>"; }
+
+    // The buffered stream; use this to write from C++.
+    std::ostream& stream() { return out; }
+
+    void write(std::string_view text);
+    void flush();
+    void set_buffer_size(std::size_t size);
+    void close();
+
+    static void flush_all();
+};
+
+
+
 //
 // Client Helpers
 //
@@ -363,7 +1052,7 @@ static inline obj* _w(long l)         { return new number(l); }
 static inline obj* _w(double d)       { return new number(d); }
 static inline obj* _w(obj *o)         { return o; }
 
-static inline obj* $$(const std::string& s)  { return symbol::intern(s); }
+static inline obj* $$(std::string_view s)     { return symbol::intern(s); }
 
 // List construction
 //static inline obj* $(void)            { return nil; }
@@ -376,6 +1065,90 @@ obj* $(T first, Objects... rest) {
     return new pair(_w(first), $(rest...));
 }
 
+
+//
+// Native function bindings
+//
+// bind_native(ctx, "name", &fn) wraps the C++ function 'fn' in a
+// builtin and defines it in 'ctx'.  The parameter and return types
+// are deduced; the builtin checks the argument count and converts
+// each argument and the result.  Supported types are double, long,
+// int, bool, std::string, std::string_view (which refers to the Sic
+// string) and obj*; a void function returns nil.  Arguments for long
+// and int parameters must be whole numbers that fit or the call
+// throws bad_arg.  (It's not called
+// plain 'bind' since argument-dependent lookup would often find
+// std::bind instead.)
+//
+
+template<typename T> struct native_arg;
+
+template<> struct native_arg<double> {
+    static double get(obj *o) { return dca<number>(o)->val; }
+};
+// Integral types check the value rather than truncating it.  The
+// upper bound is -min (i.e. max + 1) since that's exact as a double.
+template<typename I> struct native_integer {
+    static I get(obj *o) {
+        double v = dca<number>(o)->val;
+        const double lo = (double)std::numeric_limits<I>::min();
+        if (!(v == std::trunc(v) && v >= lo && v < -lo)) {
+            throw bad_arg(std::string("an integer that fits in ") +
+                          (sizeof(I) == sizeof(int) ? "an int" : "a long"),
+                          printstr(o));
+        }
+        return (I)v;
+    }
+};
+template<> struct native_arg<long> : native_integer<long> {};
+template<> struct native_arg<int> : native_integer<int> {};
+template<> struct native_arg<bool> {
+    static bool get(obj *o) { return o->isTrue(); }
+};
+template<> struct native_arg<std::string> {
+    static std::string get(obj *o) { return dca<string>(o)->str(); }
+};
+template<> struct native_arg<std::string_view> {
+    static std::string_view get(obj *o) { return dca<string>(o)->contents; }
+};
+template<> struct native_arg<obj*> {
+    static obj *get(obj *o) { return o; }
+};
+
+static inline obj* native_result(bool b)                { return b ? (obj*)t : nil; }
+static inline obj* native_result(std::string_view s)    { return new string(std::string(s)); }
+template<typename T>
+static inline obj* native_result(T value)               { return _w(value); }
+
+template<typename R, typename... Args, std::size_t... I>
+obj *native_call(R (*fn)(Args...), const std::vector<obj*>& args,
+                 std::index_sequence<I...>) {
+    if constexpr (std::is_void_v<R>) {
+        fn(native_arg<std::decay_t<Args>>::get(args[I])...);
+        return nil;
+    } else {
+        return native_result(fn(native_arg<std::decay_t<Args>>::get(args[I])...));
+    }
+}
+
+// Return a builtin that calls 'fn'.
+template<typename R, typename... Args>
+builtin *native(R (*fn)(Args...)) {
+    return new builtin(
+        sizeof...(Args), false, false,
+        [fn](std::vector<obj*>& args, context*) -> obj* {
+            return native_call(fn, args, std::index_sequence_for<Args...>{});
+        });
+}
+
+// Define 'name' in 'ctx' as a builtin that calls 'fn'.
+template<typename R, typename... Args>
+builtin *bind_native(context *ctx, const std::string& name, R (*fn)(Args...)) {
+    builtin *b = native(fn);
+    ctx->define(name, b);
+    return b;
+}
+
 //
 // basic list access
 //
@@ -395,12 +1168,220 @@ static inline obj* basic_second(obj *cell) {
 }
 
 
-static inline obj* read(std::string text) {
-    std::stringstream s(text, std::ios_base::in);
-    return read(s);
+//
+// Buffer-based reading
+//
+
+// Reader that works directly on an in-memory buffer (typically a
+// mapped_file).  This is a lot faster than going through a
+// std::istream so it's used whenever the whole input is available
+// up front.  The buffer must outlive the reader.
+class buffer_reader {
+    const char *pos;
+    const char * const end;
+
+    void skip_spaces();
+    std::string_view token(unsigned char cls);
+    obj *read_list();
+    obj *read_string();
+    obj *read_number();
+
+public:
+    explicit buffer_reader(std::string_view text) :
+        pos(text.data()), end(text.data() + text.size()) {}
+
+    // Return the next expression or nullptr at the end of input.
+    obj *read();
+};
+
+// A read-only, memory-mapped file.  Throws sic::error if 'path'
+// can't be mapped (e.g. if it's not a regular file).
+class mapped_file {
+    const char *data;
+    std::size_t size;
+public:
+    explicit mapped_file(const std::string& path);
+    mapped_file(const mapped_file&) = delete;
+    ~mapped_file();
+
+    std::string_view text() const { return std::string_view(data, size); }
+};
+
+static inline obj* read(std::string_view text) {
+    return buffer_reader(text).read();
 }
 
 
+// An expression analyzed once so that C++ code can evaluate it many
+// times.  'params' name the variables the caller supplies; each call
+// binds them to its arguments in a fresh context on top of 'ctx' and
+// evaluates the expression there.
+//
+// Preparing macro-expands the expression as far as possible (see
+// expand()) and replaces names in function position that refer to
+// builtins with the builtins themselves, so later rebinding those
+// names doesn't affect it.  Making the prepared object static builds
+// its tree only once:
+//
+//     static prepared sq(root, {"n"}, $(mul, $$("n"), $$("n")));
+//     obj *result = sq(7);
+class prepared {
+    context * const scope;
+    const std::vector<std::string> params;
+    obj * const body;
+
+public:
+    prepared(context *ctx, std::vector<std::string> params, obj *expr);
+
+    // Parses the expression from 'source'.
+    prepared(context *ctx, std::vector<std::string> params,
+             std::string_view source);
+
+    obj *call(const std::vector<obj*>& args) const;
+
+    template<typename... Args>
+    obj *operator()(Args... args) const { return call({ _w(args)... }); }
+};
+
+
+// Instrumenting profiler.  While a profiler is current (for this
+// thread), every call to a function or builtin (including macro
+// expansions) is counted and timed along with the stack of calls
+// that led to it.  When none is, the cost is a null check per call.
+class profiler {
+    using clock = std::chrono::steady_clock;
+
+    struct stats {
+        uint64_t calls = 0;
+        clock::duration inclusive{0}, self{0};
+        int active = 0;             // Recursion depth
+    };
+
+    // Call stacks are kept as a tree; node 0 is the root.
+    struct node {
+        std::size_t parent;
+        const callable *fn;
+        stats *st;
+        clock::duration self{0};
+        std::map<const callable*, std::size_t> children;
+    };
+
+    struct frame {
+        std::size_t node;
+        clock::time_point start;
+        clock::duration children{0};
+    };
+
+    std::map<const callable*, stats> by_fn;
+    std::vector<node> nodes;
+    std::vector<frame> stack;
+    profiler *previous;
+
+    static thread_local profiler *current;
+
+    void enter(const callable *fn);
+    void leave();
+
+    friend class profile_scope;
+
+public:
+    // Makes this the current profiler until it's destroyed.
+    profiler();
+    profiler(const profiler&) = delete;
+    ~profiler();
+
+    // Write a table of calls and times, busiest first.  Names are
+    // looked up in 'ctx'.
+    void report(std::ostream& out, const context *ctx) const;
+
+    // Write the call stacks in the "folded" format used by
+    // flamegraph.pl: "outer;inner;innermost <microseconds>".
+    void folded(std::ostream& out, const context *ctx) const;
+};
+
+// Times one call if profiling is on.
+class profile_scope {
+    profiler * const prof;
+public:
+    explicit profile_scope(const callable *fn) : prof(profiler::current) {
+        if (prof) { prof->enter(fn); }
+    }
+    ~profile_scope() { if (prof) { prof->leave(); } }
+};
+
+
+// Evaluation tracer.  While tracing is on, eval() records each
+// expression it starts and finishes (or leaves by exception) and
+// each callable it calls, with a timestamp, in a fixed-size ring
+// buffer shared by all threads.  Recording takes a slot with one
+// atomic increment and never allocates; the oldest events are
+// overwritten.  When tracing is off, the cost is one relaxed atomic
+// load per eval().
+//
+// Building with -DSIC_NO_TRACE removes the tracer from eval()
+// entirely; the functions below then do nothing.
+#ifndef SIC_TRACE_EVENTS
+#   define SIC_TRACE_EVENTS 8192        // Must be a power of two
+#endif
+
+class tracer {
+public:
+    enum kind : uint8_t { EVAL, RETURN, THROW, CALL };
+
+    static bool enabled();
+    static void enable(bool on);
+
+    // Ask for a dump at the next eval() on any thread.  Safe to call
+    // from a signal handler.
+    static void request_dump();
+
+    // Write the buffered events, oldest first.  Names of callables
+    // are looked up in 'ctx' if given.
+    static void dump(std::ostream& out, const context *ctx = nullptr);
+
+#ifndef SIC_NO_TRACE
+private:
+    enum : unsigned { ON = 1, DUMP = 2 };
+    static std::atomic<unsigned> flags;
+
+    static void record(kind k, const obj *what);
+    static bool enter(const obj *expr, const context *ctx);
+    static void leave(const obj *expr, bool thrown);
+
+    friend class trace_scope;
+#endif
+};
+
+#ifndef SIC_NO_TRACE
+class trace_scope {
+    const obj * const expr;
+    const int uncaught;         // -1 if not tracing
+public:
+    trace_scope(const obj *e, const context *ctx) :
+        expr(e),
+        uncaught((tracer::flags.load(std::memory_order_relaxed) &&
+                  tracer::enter(e, ctx))
+                 ? std::uncaught_exceptions() : -1)
+        {}
+    ~trace_scope() {
+        if (uncaught >= 0) {
+            tracer::leave(expr, std::uncaught_exceptions() > uncaught);
+        }
+    }
+
+    void call(const callable *fn) const {
+        if (uncaught >= 0) { tracer::record(tracer::CALL, fn); }
+    }
+};
+#else
+class trace_scope {
+public:
+    trace_scope(const obj *, const context *) {}
+    void call(const callable *) const {}
+};
+#endif
+
+
 // Include prototypes for the builtins in sic_func.inc.
 #define BUILTIN_FULL(name, x1,x2,x3)  \
     extern callable * const name;
@@ -0,0 +1,147 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// The evaluation tracer.  See class tracer in sic.hpp.
+
+#include <string>
+#include <chrono>
+#include <cstdio>
+
+#include "sic.hpp"
+
+namespace sic {
+
+#ifndef SIC_NO_TRACE
+
+static_assert((SIC_TRACE_EVENTS & (SIC_TRACE_EVENTS - 1)) == 0,
+              "SIC_TRACE_EVENTS must be a power of two");
+
+// Fields are atomic so that a dump running alongside writers sees
+// each one whole (if not always from the same event).  On the usual
+// platforms relaxed atomic loads and stores are plain moves.
+struct trace_event {
+    std::atomic<uint64_t> nsec;
+    std::atomic<const obj*> what;
+    std::atomic<uint64_t> info;         // depth << 16 | thread << 8 | kind
+};
+
+static trace_event ring[SIC_TRACE_EVENTS];
+static std::atomic<uint64_t> next_event(0);
+static std::atomic<unsigned> next_thread(0);
+
+static thread_local uint64_t depth = 0;
+static thread_local int thread_num = -1;
+
+static const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+std::atomic<unsigned> tracer::flags(0);
+
+
+void
+tracer::record(kind k, const obj *what) {
+    if (thread_num < 0) { thread_num = next_thread++ & 0xff; }
+
+    uint64_t nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+
+    trace_event& ev = ring[next_event++ & (SIC_TRACE_EVENTS - 1)];
+    ev.nsec.store(nsec, std::memory_order_relaxed);
+    ev.what.store(what, std::memory_order_relaxed);
+    ev.info.store(depth << 16 | (uint64_t)thread_num << 8 | k,
+                  std::memory_order_relaxed);
+}// record
+
+
+// Called (via trace_scope) when flags is non-zero; returns true if
+// the expression is being traced.
+bool
+tracer::enter(const obj *expr, const context *ctx) {
+    if (flags & DUMP) {
+        flags &= ~DUMP;
+        while (ctx && ctx->parent) { ctx = ctx->parent; }
+        dump(stderr_port()->stream(), ctx);
+    }
+
+    if (!(flags & ON)) { return false; }
+
+    record(EVAL, expr);
+    ++depth;
+    return true;
+}// enter
+
+
+void
+tracer::leave(const obj *expr, bool thrown) {
+    --depth;
+    record(thrown ? THROW : RETURN, expr);
+}// leave
+
+
+bool tracer::enabled() { return flags & ON; }
+
+void
+tracer::enable(bool on) {
+    if (on) {
+        flags |= ON;
+    } else {
+        flags &= ~ON;
+    }
+}// enable
+
+void tracer::request_dump() { flags |= DUMP; }
+
+
+void
+tracer::dump(std::ostream& out, const context *ctx) {
+    static const char * const marks[] = { ">", "<", "!", "call" };
+
+    uint64_t end = next_event.load();
+    uint64_t start = end > SIC_TRACE_EVENTS ? end - SIC_TRACE_EVENTS : 0;
+
+    out << "Trace (" << (end - start) << " of " << end << " events):\n";
+    for (uint64_t i = start; i < end; ++i) {
+        const trace_event& ev = ring[i & (SIC_TRACE_EVENTS - 1)];
+        const obj *what = ev.what.load(std::memory_order_relaxed);
+        uint64_t info = ev.info.load(std::memory_order_relaxed);
+        uint64_t nsec = ev.nsec.load(std::memory_order_relaxed);
+        if (!what) { continue; }
+
+        kind k = (kind)(info & 0x3);
+        unsigned thread = (info >> 8) & 0xff;
+        uint64_t level = info >> 16;
+
+        char prefix[64];
+        snprintf(prefix, sizeof(prefix), "%14.6f t%-3u ", nsec / 1e9, thread);
+
+        std::string text;
+        if (k == CALL) {
+            const callable *fn = dynamic_cast<const callable*>(what);
+            text = ctx && fn ? callable_name(fn, ctx) : printstr((obj*)what);
+        } else {
+            text = printstr((obj*)what, ctx);
+        }
+        if (text.size() > 72) { text = text.substr(0, 69) + "..."; }
+
+        out << prefix << std::string(2 * std::min<uint64_t>(level, 30), ' ')
+            << marks[k] << " " << text << "\n";
+    }// for
+
+    out.flush();
+}// dump
+
+
+#else   // SIC_NO_TRACE
+
+bool tracer::enabled() { return false; }
+void tracer::enable(bool) {}
+void tracer::request_dump() {}
+
+void
+tracer::dump(std::ostream& out, const context *) {
+    out << "Tracing was compiled out (SIC_NO_TRACE).\n";
+}
+
+#endif
+
+}// namespace sic
@@ -121,7 +121,7 @@ add_test_functions(context *ctx) {
                 bool first = true;
                 for (obj* arg : args) {
                     if (first && arg->isString()) {
-                        message = dca<string>(arg)->contents;
+                        message = dca<string>(arg)->str();
                         first = false;
                         continue;
                     }
@@ -131,12 +131,16 @@ add_test_functions(context *ctx) {
                         eval(arg, ctx);
                     } catch (const assertion_failure& e) {
                         incr(ctx, "TEST_FAILURE_COUNT");
-                        printf("FAILED %d %s %s\n", tests_run(ctx),
-                               message.c_str(), e.msg().c_str());
+                        stdout_port()->stream()
+                            << "FAILED " << tests_run(ctx) << " "
+                            << message << " " << e.msg() << "\n";
                         return nil;
                     }
                 }
-                printf("%03d PASSED\n", tests_run(ctx));
+                char passed[32];
+                snprintf(passed, sizeof(passed), "%03d PASSED\n",
+                         tests_run(ctx));
+                stdout_port()->write(passed);
                 return t;
             });
 
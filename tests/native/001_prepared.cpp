@@ -0,0 +1,46 @@
+// Tests for prepared expressions.
+
+#include "check.hpp"
+
+using namespace sic;
+
+int main() {
+    context *root = root_context();
+
+    // Built with the $() templates and parsed from text.
+    prepared hypot2(root, {"x", "y"},
+                    $(add, $(mul, $$("x"), $$("x")), $(mul, $$("y"), $$("y"))));
+    CHECK(dca<number>(hypot2(3, 4))->val == 25);
+    CHECK(dca<number>(hypot2(1.5, 2))->val == 6.25);
+
+    prepared classify(root, {"n"},
+                      "(cond ((< n 0) 'negative) ((== n 0) 'zero) (t 'positive))");
+    CHECK(printstr(classify(-3)) == "negative");
+    CHECK(printstr(classify(0)) == "zero");
+    CHECK(printstr(classify(8)) == "positive");
+
+    // Parameters are bound per call and don't leak into the scope.
+    prepared inc(root, {"n"}, "(+ n 1)");
+    CHECK(dca<number>(inc(41))->val == 42);
+    CHECK(!root->has("n"));
+
+    // Globals are looked up at call time...
+    check::run(root, "(setq scale 10)");
+    prepared scaled(root, {"n"}, "(* n scale)");
+    CHECK(dca<number>(scaled(3))->val == 30);
+    check::run(root, "(setq scale 2)");
+    CHECK(dca<number>(scaled(3))->val == 6);
+
+    // ...but builtins in function position are resolved up front.
+    check::run(root, "(tl-set '+ -)");
+    CHECK(dca<number>(inc(1))->val == 2);
+
+    // Parameters shadow builtins of the same name.
+    prepared list_param(root, {"list"}, "(first list)");
+    CHECK(dca<number>(list_param(check::run(root, "'(7 8)")))->val == 7);
+
+    CHECK_THROWS(arg_count, inc(1, 2));
+    CHECK_THROWS(syntax_error, prepared(root, {}, ""));
+
+    return check::failures;
+}
@@ -0,0 +1,65 @@
+// Tests for native function bindings.
+
+#include "check.hpp"
+
+#include <cmath>
+
+using namespace sic;
+
+static double hypotenuse(double a, double b) { return std::sqrt(a*a + b*b); }
+static long twice(long n) { return 2 * n; }
+static long negate(int n) { return -(long)n; }
+static bool is_even(long n) { return n % 2 == 0; }
+static std::string shout(const std::string& s) { return s + "!"; }
+static long length(std::string_view s) { return (long)s.size(); }
+static obj *second_of(obj *list) { return basic_second(list); }
+
+static int calls = 0;
+static void bump() { ++calls; }
+
+int main() {
+    context *root = root_context();
+
+    bind_native(root, "hypotenuse", &hypotenuse);
+    bind_native(root, "twice", &twice);
+    bind_native(root, "negate", &negate);
+    bind_native(root, "even?", &is_even);
+    bind_native(root, "shout", &shout);
+    bind_native(root, "length", &length);
+    bind_native(root, "second-of", &second_of);
+    bind_native(root, "bump", &bump);
+
+    CHECK(check::show(root, "(hypotenuse 3 4)") == "5");
+    CHECK(check::show(root, "(twice 21)") == "42");
+    CHECK(check::show(root, "(negate 5)") == "-5");
+    CHECK(check::run(root, "(even? 4)") == t);
+    CHECK(check::run(root, "(even? 5)") == nil);
+    CHECK(check::show(root, "(shout \"hey\")") == "hey!");
+    CHECK(check::show(root, "(length \"four\")") == "4");
+    CHECK(check::show(root, "(second-of '(a b c))") == "b");
+
+    CHECK(check::run(root, "(bump)") == nil);
+    CHECK(calls == 1);
+
+    // Functions from native() can be used like any other callable.
+    CHECK(check::show(root, "(map twice '(1 2 3))") == "(2 4 6)");
+
+    CHECK_THROWS(arg_count, check::run(root, "(twice 1 2)"));
+    CHECK_THROWS(arg_count, check::run(root, "(twice)"));
+    CHECK_THROWS(wrong_type, check::run(root, "(twice \"x\")"));
+    CHECK_THROWS(wrong_type, check::run(root, "(shout 3)"));
+
+    // Integers are range-checked rather than truncated.
+    CHECK(check::show(root, "(negate -2147483648)") == "2147483648");
+    CHECK_THROWS(bad_arg, check::run(root, "(negate 2147483648)"));
+    CHECK_THROWS(bad_arg, check::run(root, "(negate -2147483649)"));
+    CHECK_THROWS(bad_arg, check::run(root, "(twice 1.5)"));
+    CHECK_THROWS(bad_arg, check::run(root, "(twice (/ 1 0))"));
+    CHECK_THROWS(bad_arg, check::run(root, "(twice 9223372036854775808)"));
+    CHECK(check::show(root, "(twice -4611686018427387904)") ==
+          check::show(root, "(- 0 9223372036854775808)"));
+
+    CHECK_THROWS(redefined_name, bind_native(root, "twice", &twice));
+
+    return check::failures;
+}
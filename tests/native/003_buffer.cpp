@@ -0,0 +1,73 @@
+// Tests for foreign buffers.
+
+#include "check.hpp"
+
+#include <cstdint>
+#include <vector>
+
+using namespace sic;
+
+int main() {
+    context *root = root_context();
+
+    std::vector<double> samples = { 0.5, 1, 1.5, 2, 2.5 };
+    root->define("samples", new foreign_buffer(samples.data(), samples.size()));
+
+    const int16_t raw[] = { -2, 7, 300, 12 };
+    root->define("raw", new foreign_buffer(raw, 4));
+
+    const uint8_t bytes[] = { 0, 128, 255 };
+    root->define("bytes", new foreign_buffer(bytes, 3));
+
+    // Element types are deduced from the pointer.
+    CHECK(check::show(root, "(buffer-type samples)") == "f64");
+    CHECK(check::show(root, "(buffer-type raw)") == "i16");
+    CHECK(check::show(root, "(buffer-type bytes)") == "u8");
+    CHECK(check::run(root, "(buffer? raw)") == t);
+    CHECK(check::run(root, "(buffer? '(1 2))") == nil);
+
+    // Sic reads the host's memory in place.
+    CHECK(check::show(root, "(llen samples)") == "5");
+    CHECK(dca<number>(check::run(root, "(fold + 0 samples)"))->val == 7.5);
+    CHECK(check::show(root, "(nth raw 2)") == "300");
+    CHECK(check::show(root, "(map (fun (x) (* x 2)) raw)") == "(-4 14 600 24)");
+    CHECK(check::show(root, "(to-list bytes)") == "(0 128 255)");
+    samples[0] = 10;
+    CHECK(check::show(root, "(nth samples 0)") == "10");
+
+    // Out of range is nil and slices are clipped.
+    CHECK(check::run(root, "(nth raw 4)") == nil);
+    CHECK(check::show(root, "(to-list (slice raw 1 3))") == "(7 300)");
+    CHECK(check::show(root, "(llen (slice raw 3 100))") == "1");
+    CHECK(check::show(root, "(llen (slice raw 3 1))") == "0");
+
+    // From C++.
+    foreign_buffer *buf = new foreign_buffer(raw, 4);
+    CHECK(buf->size() == 4);
+    CHECK(buf->value(1) == 7);
+    CHECK(buf->at(-1) == nil);
+    CHECK(buf->slice(1, 3)->value(0) == 7);
+    CHECK(buf->str() == "<buffer i16[4]>");
+
+    // An untyped pointer with an explicit element type.
+    const uint32_t words[] = { 1, 4000000000u };
+    foreign_buffer *w = new foreign_buffer((const void *)words, 2,
+                                           foreign_buffer::UINT32);
+    CHECK(w->value(1) == 4000000000.0);
+
+    // The release callback runs when the last view goes away, so a
+    // slice keeps the memory alive.
+    int released = 0;
+    {
+        foreign_buffer owned(raw, 4, [&]() { ++released; });
+    }
+    CHECK(released == 1);
+    {
+        foreign_buffer owned(raw, 4, [&]() { ++released; });
+        root->define("part", owned.slice(0, 2));
+    }
+    CHECK(released == 1);
+    CHECK(check::show(root, "(to-list part)") == "(-2 7)");
+
+    return check::failures;
+}
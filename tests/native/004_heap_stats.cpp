@@ -0,0 +1,46 @@
+// Tests for allocation accounting across threads.
+
+#include "check.hpp"
+
+#include <thread>
+
+using namespace sic;
+
+// Objects allocated by 'fn' according to this thread's counters.
+static uint64_t
+objects_by(const callable *fn) {
+    for (const auto& site : heap_stats::all()) {
+        if (site.first != fn) { continue; }
+
+        uint64_t total = 0;
+        for (int k = 0; k < heap_stats::KINDS; ++k) {
+            total += site.second->objects[k];
+        }
+        return total;
+    }
+    return 0;
+}// objects_by
+
+
+int main() {
+    context *root = root_context();
+    check::run(root, "(defun make-list (n) (list n n n))");
+    callable *make_list = dca<callable>(root->get("make-list"));
+
+    // The first call happens on a thread that then exits...
+    std::thread first([&]() {
+            check::run(root, "(make-list 1)");
+            CHECK(objects_by(make_list) > 0);
+        });
+    first.join();
+
+    // ...and this thread still gets counters of its own.
+    CHECK(objects_by(make_list) == 0);
+    check::run(root, "(make-list 2)");
+    uint64_t once = objects_by(make_list);
+    CHECK(once > 0);
+    check::run(root, "(make-list 3)");
+    CHECK(objects_by(make_list) == 2 * once);
+
+    return check::failures;
+}
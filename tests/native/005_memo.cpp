@@ -0,0 +1,47 @@
+// Tests for calling a memoized function from several threads.
+
+#include "check.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace sic;
+
+int main() {
+    context *root = root_context();
+    check::run(root, "(defun-memo fib (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    memoized *fib = dca<memoized>(root->get("fib"));
+
+    const int threads = 4, rounds = 200;
+    std::vector<std::thread> workers;
+    std::vector<double> results(threads * rounds);
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+                for (int r = 0; r < rounds; ++r) {
+                    obj *n = new number((long)(r % 60));
+                    results[i * rounds + r] =
+                        dca<number>(fib->call($(n), root))->val;
+                    if (r % 50 == 0) { fib->clear(); }
+                }
+            });
+    }
+    for (auto& w : workers) { w.join(); }
+
+    double a = 0, b = 1;
+    std::vector<double> want = { 0 };
+    for (int i = 1; i < 60; ++i) { want.push_back(b); double c = a + b; a = b; b = c; }
+
+    bool all_right = true;
+    for (int i = 0; i < threads * rounds; ++i) {
+        all_right = all_right && results[i] == want[(i % rounds) % 60];
+    }
+    CHECK(all_right);
+    CHECK(fib->size() <= 60);
+
+    fib->clear();
+    CHECK(fib->size() == 0 && fib->hits() == 0 && fib->misses() == 0);
+    CHECK(check::show(root, "(fib 30)") == "832040");
+    CHECK(fib->misses() == 31);
+
+    return check::failures;
+}
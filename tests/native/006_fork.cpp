@@ -0,0 +1,114 @@
+// Tests for frozen contexts and their forks.
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sic;
+
+int main() {
+    context *base = root_context();
+    check::run(base, "(setq greeting \"hello, \")");
+    check::run(base, "(setq count 0)");
+    check::run(base, "(defun greet (name) (concat greeting name))");
+    check::run(base, "(defun bump () (setq count (+ count 1)))");
+    base->freeze();
+
+    // A fork sees the frozen bindings.
+    context *a = base->fork();
+    CHECK(a->is_frozen() == false);
+    CHECK(check::show(a, "greeting") == "hello, ");
+    CHECK(check::show(a, "(greet \"a\")") == "hello, a");
+    CHECK(check::show(a, "(+ 1 2)") == "3");
+
+    // Changes made in one fork are invisible to its siblings and to
+    // the base.
+    context *b = base->fork();
+    check::run(a, "(setq greeting \"hi, \")");
+    check::run(a, "(tl-set 'only-a 1)");
+    CHECK(check::show(a, "greeting") == "hi, ");
+    CHECK(check::show(b, "greeting") == "hello, ");
+    CHECK(dca<string>(base->get("greeting"))->contents == "hello, ");
+    CHECK(a->has("only-a"));
+    CHECK(!b->has("only-a"));
+    CHECK(!base->has("only-a"));
+
+    // Functions from the base run in the calling fork, so they read
+    // and write that fork's globals.
+    CHECK(check::show(a, "(greet \"a\")") == "hi, a");
+    CHECK(check::show(b, "(greet \"b\")") == "hello, b");
+    check::run(a, "(bump)");
+    check::run(a, "(bump)");
+    check::run(b, "(bump)");
+    CHECK(check::show(a, "count") == "2");
+    CHECK(check::show(b, "count") == "1");
+    CHECK(check::show(base->fork(), "count") == "0");
+
+    // The frozen context itself can't be changed.
+    CHECK_THROWS(frozen_context, check::run(base, "(setq count 5)"));
+    CHECK_THROWS(frozen_context, check::run(base, "(tl-set 'fresh 1)"));
+    CHECK_THROWS(frozen_context, check::run(base, "(defun greet (n) n)"));
+    CHECK_THROWS(frozen_context, base->define("fresh", nil));
+    CHECK(!base->has("fresh"));
+
+    // Defining an inherited name is a redefinition, as it would be
+    // in the base; a fork can still shadow it locally or replace it
+    // with setq.
+    CHECK_THROWS(redefined_name, b->define("greeting", nil));
+    b->define("fresh", t);
+    CHECK(b->get("fresh") == t);
+    CHECK(check::show(b, "(let ((greeting \"hey, \")) (greet \"b\"))")
+          == "hello, b");
+    CHECK(check::show(b, "(let ((count 10)) count)") == "10");
+    CHECK(check::show(b, "count") == "1");
+
+    // Forks of a fork see both layers.
+    a->freeze();
+    context *aa = a->fork();
+    CHECK(check::show(aa, "(list greeting count only-a)")
+          == "(hi,  2 1)");
+    check::run(aa, "(bump)");
+    CHECK(check::show(aa, "count") == "3");
+    CHECK(check::show(a, "count") == "2");
+
+    // An image of a fork includes what it inherits.
+    std::string path = "006_fork.img";
+    save_image(b, path);
+    context *loaded = root_context();
+    load_image(loaded, path);
+    std::remove(path.c_str());
+    CHECK(check::show(loaded, "(list (greet \"c\") count fresh)")
+          == "(hello, c 1 t)");
+    check::run(loaded, "(bump)");
+    CHECK(check::show(loaded, "count") == "2");
+
+    // Forks can be made and used from several threads at once.
+    context *shared = root_context();
+    check::run(shared, "(setq total 0)");
+    check::run(shared, "(defun add (n) (setq total (+ total n)))");
+
+    std::vector<std::thread> threads;
+    std::vector<std::string> totals(4);
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([shared, i, &totals] {
+            context *mine = shared->fork();
+            for (int n = 0; n <= 100; ++n) {
+                std::string call = "(add " + std::to_string(n * (i + 1)) + ")";
+                eval(read(call), mine);
+            }
+            totals[i] = printstr(mine->get("total"));
+        });
+    }
+    for (auto& th : threads) { th.join(); }
+
+    for (int i = 0; i < 4; ++i) {
+        CHECK(totals[i] == std::to_string(5050 * (i + 1)));
+    }
+    CHECK(shared->is_frozen());
+    CHECK(check::show(shared, "total") == "0");
+
+    return check::failures;
+}
@@ -0,0 +1,114 @@
+// Tests for evaluation budgets.
+
+#include "check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace sic;
+
+int main() {
+    context *root = root_context();
+    check::run(root, "(defun spin () (while t nil))");
+    check::run(root, "(defun deep (n) (+ 1 (deep n)))");
+    check::run(root, "(setq items (to-list (range 1000)))");
+    check::run(root, "(setq words (map (lambda (n) \"w\") items))");
+
+    std::vector<double> samples(1000, 1.5);
+    root->define("samples", new foreign_buffer(samples.data(), samples.size()));
+
+    // Each kind of limit stops evaluation with budget_exceeded.
+    {
+        budget limits;
+        limits.steps(1000);
+        CHECK_THROWS(budget_exceeded, check::run(root, "(spin)"));
+        CHECK(limits.used() == 1000);
+    }
+    {
+        budget limits;
+        limits.max_depth(100);
+        CHECK_THROWS(budget_exceeded, check::run(root, "(deep 1)"));
+    }
+    {
+        budget limits;
+        limits.timeout(std::chrono::milliseconds(10));
+        CHECK_THROWS(budget_exceeded, check::run(root, "(spin)"));
+    }
+    {
+        budget limits;
+        limits.memory(1 << 16);
+        CHECK_THROWS(budget_exceeded,
+                     check::run(root, "(to-list (range 100000))"));
+    }
+    {
+        std::atomic<bool> stop(true);
+        budget limits;
+        limits.cancel_flag(&stop);
+        CHECK_THROWS(budget_exceeded, check::run(root, "(spin)"));
+    }
+
+    // Loops inside builtins are charged per item even when the
+    // function they call is itself a builtin and so never reaches
+    // eval.
+    const char *loops[] = {
+        "(map abs items)",
+        "(each abs items)",
+        "(fold + 0 items)",
+        "(filter abs items)",
+        "(sort items >)",
+        "(to-list (seq items))",
+        "(each abs samples)",
+        "(join words)",
+    };
+    for (const char *loop : loops) {
+        budget limits;
+        limits.steps(100);
+        bool thrown = false;
+        try { check::run(root, loop); } catch (const budget_exceeded&) {
+            thrown = true;
+        }
+        if (!thrown) { check::fail(__FILE__, __LINE__, loop); }
+    }
+
+    // Waiting on a channel is cut short by a deadline or cancellation
+    // even though no steps are taken while it waits.
+    check::run(root, "(setq empty (make-channel 1))");
+    check::run(root, "(setq full (make-channel 1))");
+    check::run(root, "(send full 1)");
+    {
+        budget limits;
+        limits.timeout(std::chrono::milliseconds(50));
+        CHECK_THROWS(budget_exceeded, check::run(root, "(recv empty)"));
+    }
+    CHECK_THROWS(budget_exceeded,
+                 check::run(root, "(with-budget '(ms 50) (send full 2))"));
+    {
+        std::atomic<bool> stop(false);
+        std::thread canceller([&stop] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            stop = true;
+        });
+        budget limits;
+        limits.cancel_flag(&stop);
+        CHECK_THROWS(budget_exceeded, check::run(root, "(recv empty)"));
+        canceller.join();
+    }
+
+    // The channels still work afterward.
+    CHECK(check::show(root, "(recv full)") == "1");
+    check::run(root, "(send empty 3)");
+    CHECK(check::show(root, "(recv empty)") == "3");
+
+    // Work within the limits is unaffected, and leaving a budget's
+    // scope lifts its limits.
+    {
+        budget limits;
+        limits.steps(5000);
+        CHECK(check::show(root, "(fold + 0 items)") == "499500");
+    }
+    CHECK(check::show(root, "(llen (map abs items))") == "1000");
+
+    return check::failures;
+}
@@ -0,0 +1,85 @@
+// Check that the stream reader (used by ports and the REPL) and the
+// buffer reader (used for scripts and strings) agree.
+
+#include "check.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace sic;
+
+// Every form in 'text', printed for debugging, as read by each reader.
+static std::vector<std::string>
+stream_forms(const std::string& text) {
+    std::istringstream in(text);
+    std::vector<std::string> forms;
+    for (obj *form = read(in); form; form = read(in)) {
+        forms.push_back(printstr(form, nullptr, true));
+    }
+    return forms;
+}// stream_forms
+
+static std::vector<std::string>
+buffer_forms(const std::string& text) {
+    buffer_reader reader(text);
+    std::vector<std::string> forms;
+    for (obj *form = reader.read(); form; form = reader.read()) {
+        forms.push_back(printstr(form, nullptr, true));
+    }
+    return forms;
+}// buffer_forms
+
+static void
+same(const std::string& text) {
+    std::vector<std::string> want = stream_forms(text);
+    std::vector<std::string> got = buffer_forms(text);
+    if (got == want) { return; }
+
+    std::string what = "readers agree on '" + text + "': stream gave";
+    for (const std::string& f : want) { what += " " + f; }
+    what += "; buffer gave";
+    for (const std::string& f : got) { what += " " + f; }
+    check::fail(__FILE__, __LINE__, what);
+}// same
+
+
+int main() {
+    // Atoms
+    same("42 0 -7 3.5 -0.25 12. 007 1.25 -10.125");
+    same("foo foo-bar? set! a_b x1 CamelCase");
+    same("+ - * / <= -> != ++ -x");
+    same("\"\" \"a string\" \"with \\\"quotes\\\"\" \"tab\\there\" \"new\\nline\"");
+
+    // Structure
+    same("() (1) (1 2 3) ((a) (b (c)) ())");
+    same("'x '(1 2) ''y '()");
+    same("(defun f (a b) (if (< a b) \"less\" '(1 2.5 -3 sym)))");
+
+    // Spacing and comments
+    same("  (a\tb\n c)  \n\n ");
+    same("; a comment\n(a ; another\n b)\n# hash comment\nc");
+    same("(a)(b)'c\"d\"e");
+
+    // A longer generated input, like the reader benchmark's.
+    std::string many;
+    for (int i = 0; i < 200; ++i) {
+        many += "(setq v" + std::to_string(i) + " (list " +
+            std::to_string(i * 7) + "." + std::to_string(i % 10) +
+            " \"s" + std::to_string(i) + "\" 'sym -" + std::to_string(i) +
+            "))\n";
+    }
+    same(many);
+
+    // Both readers reject malformed input.
+    CHECK_THROWS(syntax_error, buffer_forms("(a b"));
+    CHECK_THROWS(syntax_error, stream_forms("(a b"));
+    CHECK_THROWS(syntax_error, buffer_forms("\"open"));
+    CHECK_THROWS(syntax_error, stream_forms("\"open"));
+    for (const char *stray : {")", "]", "a . b", "1.5.5"}) {
+        CHECK_THROWS(syntax_error, buffer_forms(stray));
+        CHECK_THROWS(syntax_error, stream_forms(stray));
+    }
+
+    return check::failures;
+}
@@ -0,0 +1,46 @@
+// Test that calling a builtin doesn't allocate (its argument vector
+// is reused from call to call).
+
+#include "check.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace sic;
+
+static std::atomic<long> allocations(0);
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *p = std::malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+
+int main() {
+    context *root = root_context();
+    check::run(root, "(setq items (to-list (range 10000)))");
+
+    // 'not' allocates nothing itself and 'each' passes it each item
+    // with callable::apply, so only setting up the call allocates.
+    obj *loop = read("(each not items)");
+    check::run(root, "(each not items)");     // Warm up
+
+    long before = allocations;
+    eval(loop, root);
+    CHECK(allocations - before < 100);
+
+    // The same for builtin::call, which takes its arguments as a list.
+    callable *not_fn = dca<callable>(root->get("not"));
+    obj *args = read("(1)");
+    not_fn->call(args, root);
+
+    before = allocations;
+    for (int i = 0; i < 10000; ++i) { not_fn->call(args, root); }
+    CHECK(allocations - before < 100);
+
+    return check::failures;
+}
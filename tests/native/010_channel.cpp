@@ -0,0 +1,107 @@
+// Tests for channels shared between threads.
+
+#include "check.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace sic;
+
+// Push 'per_producer' values through a channel of 'capacity' from
+// each of several producers to several consumers and check that
+// every value arrives exactly once.
+static void
+many_to_many(std::size_t capacity, int producers, int consumers,
+             long per_producer)
+{
+    long total = producers * per_producer;
+    std::vector<obj*> values;
+    for (long n = 0; n < total; ++n) { values.push_back(new number(n)); }
+
+    channel ch(capacity);
+    std::atomic<long> count(0), sum(0);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (long n = 0; n < per_producer; ++n) {
+                ch.send(values[p * per_producer + n]);
+            }
+        });
+    }
+
+    // Consumers split the values as evenly as possible.
+    for (int c = 0; c < consumers; ++c) {
+        long mine = total / consumers + (c < total % consumers ? 1 : 0);
+        threads.emplace_back([&, mine] {
+            for (long n = 0; n < mine; ++n) {
+                sum += (long)dca<number>(ch.recv())->val;
+                ++count;
+            }
+        });
+    }
+
+    for (auto& th : threads) { th.join(); }
+
+    CHECK(count == total);
+    CHECK(sum == total * (total - 1) / 2);
+
+    obj *left;
+    CHECK(!ch.try_recv(left));
+}// many_to_many
+
+
+int main() {
+    obj *one = new number(1.0), *two = new number(2.0);
+
+    // A one-value channel holds one value.
+    {
+        channel ch(1);
+        CHECK(ch.try_send(one));
+        CHECK(!ch.try_send(two));
+
+        obj *got = nil;
+        CHECK(ch.try_recv(got) && got == one);
+        CHECK(!ch.try_recv(got));
+        CHECK(ch.try_send(two));
+        CHECK(ch.try_recv(got) && got == two);
+    }
+
+    // Sending on a full channel waits for a receiver.
+    for (std::size_t capacity : {1, 2, 8}) {
+        channel ch(capacity);
+        for (std::size_t i = 0; i < capacity; ++i) { ch.send(one); }
+
+        std::atomic<bool> sent(false);
+        std::thread sender([&] { ch.send(two); sent = true; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(!sent);
+
+        CHECK(ch.recv() == one);
+        sender.join();
+        CHECK(sent);
+        for (std::size_t i = 1; i < capacity; ++i) { CHECK(ch.recv() == one); }
+        CHECK(ch.recv() == two);
+    }
+
+    // Receiving on an empty channel waits for a sender.
+    {
+        channel ch(1);
+        obj *got = nil;
+        std::thread receiver([&] { got = ch.recv(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ch.send(two);
+        receiver.join();
+        CHECK(got == two);
+    }
+
+    for (std::size_t capacity : {1, 2, 4, 64}) {
+        many_to_many(capacity, 4, 4, 5000);
+        many_to_many(capacity, 1, 4, 5000);
+        many_to_many(capacity, 4, 1, 5000);
+    }
+
+    return check::failures;
+}
@@ -0,0 +1,55 @@
+// Tests for where the profiler's table goes.
+
+#include "check.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+using namespace sic;
+
+// Evaluate 'source' with stderr captured; returns what was written.
+static std::string
+captured(context *ctx, const char *source, std::string& value) {
+    std::ostringstream err;
+    std::streambuf *saved = std::cerr.rdbuf(err.rdbuf());
+    try {
+        value = check::show(ctx, source);
+    } catch (...) {
+        std::cerr.rdbuf(saved);
+        throw;
+    }
+    std::cerr.rdbuf(saved);
+    return err.str();
+}// captured
+
+
+int main() {
+    context *root = root_context();
+    check::run(root, "(defun countdown (n) (if (<= n 0) 'done (countdown (- n 1))))");
+    check::run(root, "(setq n 7)");
+    check::run(root, "(setq foldfile \"011_profile.folded\")");
+
+    std::string value;
+
+    // Without a port, the table goes to stderr.
+    std::string table = captured(root, "(profile (countdown 3))", value);
+    CHECK(value == "done");
+    CHECK(table.find("countdown") != std::string::npos);
+
+    // A leading variable that doesn't hold a port is the expression.
+    table = captured(root, "(profile n foldfile)", value);
+    CHECK(value == "7");
+    CHECK(table.find("calls") != std::string::npos);
+    std::remove("011_profile.folded");
+
+    // With a port, nothing goes to stderr.
+    check::run(root, "(setq out (open-output \"011_profile.txt\"))");
+    table = captured(root, "(profile out (countdown 3))", value);
+    check::run(root, "(close-port out)");
+    std::remove("011_profile.txt");
+    CHECK(value == "done");
+    CHECK(table.empty());
+
+    return check::failures;
+}
@@ -0,0 +1,50 @@
+// Tests for builtins that take indexes or counts: NaN and infinite
+// values are errors, and huge ones are clipped like any other index
+// past the end.
+
+#include "check.hpp"
+
+#include <vector>
+
+using namespace sic;
+
+int main() {
+    context *root = root_context();
+    check::run(root, "(setq nan (/ 0 0))");
+    check::run(root, "(setq inf (/ 1 0))");
+    check::run(root, "(setq big (* 1000000000 1000000000 1000000000 1000000000))");
+
+    std::vector<double> samples(4, 1.5);
+    root->define("samples", new foreign_buffer(samples.data(), samples.size()));
+
+    const char *bad[] = {
+        "(substring \"abc\" nan)",
+        "(substring \"abc\" 0 nan)",
+        "(substring \"abc\" inf)",
+        "(string-find \"abc\" \"b\" nan)",
+        "(take nan '(1 2 3))",
+        "(drop inf '(1 2 3))",
+        "(take inf (range 0 nil))",
+        "(nth '(1 2 3) nan)",
+        "(slice samples nan)",
+        "(make-channel inf)",
+        "(memoize abs nan)",
+    };
+    for (const char *expr : bad) {
+        bool thrown = false;
+        try { check::run(root, expr); } catch (const bad_arg&) {
+            thrown = true;
+        }
+        if (!thrown) { check::fail(__FILE__, __LINE__, expr); }
+    }
+
+    CHECK(check::show(root, "(substring \"abc\" 1 big)") == "bc");
+    CHECK(check::show(root, "(substring \"abc\" (- 0 big))") == "abc");
+    CHECK(check::show(root, "(string-find \"abc\" \"b\" (- 0 big))") == "1");
+    CHECK(check::show(root, "(string-find \"abc\" \"b\" big)") == "'()");
+    CHECK(check::show(root, "(take big '(1 2 3))") == "(1 2 3)");
+    CHECK(check::show(root, "(drop big '(1 2 3))") == "'()");
+    CHECK(check::show(root, "(llen (to-list (slice samples 1 big)))") == "3");
+
+    return check::failures;
+}
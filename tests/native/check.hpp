@@ -0,0 +1,52 @@
+// This file is part of Sic; Copyright (C) 2019 The Author(s)
+// LGPLv2 w/ exemption; NO WARRANTY! See Copyright.txt for details
+
+// A tiny harness for the C++ tests.  Each test is a program that runs
+// its checks and returns check::failures from main().
+
+#ifndef SIC_TEST_CHECK_HPP
+#define SIC_TEST_CHECK_HPP
+
+#include <iostream>
+#include <string>
+
+#include <sic.hpp>
+
+namespace check {
+
+inline int failures = 0;
+
+inline void fail(const char *file, int line, const std::string& what) {
+    std::cout << file << ":" << line << ": check failed: " << what << "\n";
+    ++failures;
+}
+
+// Evaluate the Sic expression in 'source'.
+inline sic::obj *run(sic::context *ctx, const char *source) {
+    return sic::eval(sic::read(source), ctx);
+}
+
+// Evaluate 'source' and return the printed result.
+inline std::string show(sic::context *ctx, const char *source) {
+    return sic::printstr(run(ctx, source));
+}
+
+}// namespace check
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) { check::fail(__FILE__, __LINE__, #cond); }        \
+    } while (0)
+
+// Check that 'expr' throws 'type' (or a subclass).  Other exceptions
+// are left to escape and fail the test.
+#define CHECK_THROWS(type, expr)                                        \
+    do {                                                                \
+        bool thrown_ = false;                                           \
+        try { (void)(expr); } catch (const type&) { thrown_ = true; }   \
+        if (!thrown_) {                                                 \
+            check::fail(__FILE__, __LINE__, #expr " throws " #type);   \
+        }                                                               \
+    } while (0)
+
+#endif
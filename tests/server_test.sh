@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# Test the server mode: start a server on a temporary socket and check
+# the output and exit status of a good and a bad request.
+
+cd -P "$(dirname "${BASH_SOURCE[0]}")"  # cd to the test directory
+
+sic=../src/sic
+dir=$(mktemp -d)
+socket=$dir/sic.sock
+status=0
+
+$sic --serve $socket &
+server=$!
+trap 'kill $server; rm -rf $dir' EXIT
+
+for i in $(seq 50); do
+    [[ -S $socket ]] && break
+    sleep 0.1
+done
+
+check() {
+    local name="$1" script="$2" want_status="$3" want_output="$4"
+
+    echo -n "$name  "
+    output=$(echo "$script" | $sic --connect $socket 2>&1)
+    got_status=$?
+
+    if [[ $got_status = $want_status && "$output" == $want_output ]]; then
+        echo "PASSED!"
+    else
+        echo "FAILED!"
+        echo "status $got_status (wanted $want_status), output:"
+        echo "$output"
+        status=1
+    fi
+}
+
+check server_ok '(print (+ 40 2))' 0 '42'
+check server_error '(print "before") (no-such-function)' 1 \
+      'before*undefined_name: no-such-function*'
+check server_define '(setq fresh 1) (print fresh)' 0 '1'
+check server_isolated '(print fresh)' 1 '*undefined_name: fresh*'
+
+exit $status